@@ -4,6 +4,11 @@
 //#include <iostream>
 //#include <vector>
 //#include <cmath>
+//#include <algorithm>
+//#include <chrono>
+//#include <cstdint>
+//#include <memory>
+//#include <random>
 //#define M_PI 3.14159265358979323846
 //
 //// GLM for math
@@ -11,16 +16,34 @@
 //#include <glm/gtc/matrix_transform.hpp>
 //#include <glm/gtc/type_ptr.hpp>
 //
-//const int NUM_PARTICLES = 500;
+//#include "thread_pool.h"
+//#include "sim_config.h"
+//#include "radix_sort.h"
+//
+//const int DEFAULT_PARTICLES = 500;   // override with --particles
+//const int MAX_PARTICLES = 16 << 20;
+//const int SOLVER_THREADS = 0;        // 0 = all hardware threads, override with --threads
+//const int REORDER_INTERVAL = 0;      // steps between Morton reorders (0 = never), override with --reorder
 //const float PARTICLE_MASS = 1.0f;
 //const float REST_DENSITY = 1000.0f; // kg/m³
 //const float GAS_STIFFNESS = 2000.0f;
 //const float VISCOSITY = 250.0f;
 //const float KERNEL_RADIUS = 0.04f; // h
+//const float PARTICLE_SPACING = 0.02f; // initial lattice spacing
 //const float GRAVITY = 9.8f;
 //const float DT = 0.001f;
 //const float BOUNDARY = 0.5f; // [-BOUNDARY, BOUNDARY]^2
 //
+//// Resolution, chosen at startup. More particles than the default shrink the
+//// initial spacing by s = sqrt(DEFAULT_PARTICLES / count) so they fill the same dam
+//// block; the kernel radius and time step shrink by s too and the mass by s³, which
+//// keeps the rest density and the number of neighbours per particle unchanged.
+//int numParticles = DEFAULT_PARTICLES;
+//float kernelRadius = KERNEL_RADIUS;
+//float particleMass = PARTICLE_MASS;
+//float particleSpacing = PARTICLE_SPACING;
+//float timeStep = DT;
+//
 //struct Vec2 {
 //    float x, y;
 //    Vec2(float x = 0, float y = 0) : x(x), y(y) {}
@@ -29,6 +52,7 @@
 //    Vec2 operator*(float s) const { return Vec2(x * s, y * s); }
 //    Vec2 operator/(float s) const { return Vec2(x / s, y / s); }
 //    float length() const { return sqrtf(x * x + y * y); }
+//    float lengthSquared() const { return x * x + y * y; }
 //    Vec2 normalize() const {
 //        float l = length();
 //        return l > 0 ? Vec2(x / l, y / l) : Vec2(0, 0);
@@ -40,110 +64,429 @@
 //    float density, pressure;
 //};
 //
-//std::vector<Particle> particles(NUM_PARTICLES);
+//std::vector<Particle> particles;
+//std::vector<Vec2> accelerations; // written by computeForces(), applied by integrate()
+//
+//// Neighbour grid: square cells of side kernelRadius over the whole domain, rebuilt
+//// every step with a counting sort. The particles of cell c are
+//// cellParticles[cellStart[c] .. cellStart[c + 1]), so every particle within the
+//// kernel radius of p lies in the 3x3 cells around p's own.
+//int gridCells = 0;               // cells per side
+//std::vector<int> particleCell;   // cell of each particle
+//std::vector<int> cellStart;      // gridCells² + 1 offsets into cellParticles
+//std::vector<int> cellCursor;     // scatter position of each cell during buildGrid()
+//std::vector<int> cellParticles;  // particle indices grouped by cell, ascending within a cell
+//
+//// Morton reorder: every reorderInterval steps the particles are sorted by the Z-order
+//// code of their grid cell, so particles close in space are close in memory and the
+//// 3x3 neighbour loops read a few runs of cache lines instead of scattered ones.
+//int reorderInterval = REORDER_INTERVAL;
+//long long stepCount = 0;
+//RadixSorter radixSorter;
+//std::vector<uint32_t> mortonKeys;
+//std::vector<uint32_t> mortonOrder;      // source index of each sorted particle
+//std::vector<Particle> reorderScratch;
+//
+//std::unique_ptr<ThreadPool> pool;
 //
 //// OpenGL objects
 //GLuint VAO, VBO;
 //GLuint shaderProgram;
 //
 //// --- Kernels ---
-//float poly6(float r, float h) {
-//    if (r >= h) return 0.0f;
-//    float tmp = h * h - r * r;
-//    return 315.0f / (64.0f * M_PI * powf(h, 9)) * powf(tmp, 3);
+//// The normalisation constants depend only on h; setResolution() computes them once
+//// instead of calling powf for every pair.
+//float kernelRadius2 = 0.0f;
+//float poly6Coef = 0.0f;     // 315 / (64 pi h^9)
+//float spikyCoef = 0.0f;     // -45 / (pi h^6)
+//float viscosityCoef = 0.0f; // 45 / (pi h^6)
+//
+//// Takes the squared distance; the caller has checked r2 < h²
+//inline float poly6(float r2) {
+//    float tmp = kernelRadius2 - r2;
+//    return poly6Coef * tmp * tmp * tmp;
+//}
+//
+//inline Vec2 spikyGradient(float r, const Vec2& dir) {
+//    if (r == 0) return Vec2(0, 0);
+//    float tmp = kernelRadius - r;
+//    return dir * (spikyCoef * tmp * tmp);
+//}
+//
+//// --- Resolution ---
+//void setResolution(int count) {
+//    numParticles = count;
+//    float s = count > DEFAULT_PARTICLES ? sqrtf((float)DEFAULT_PARTICLES / count) : 1.0f;
+//    kernelRadius = KERNEL_RADIUS * s;
+//    particleMass = PARTICLE_MASS * s * s * s;
+//    particleSpacing = PARTICLE_SPACING * s;
+//    timeStep = DT * s;
+//
+//    kernelRadius2 = kernelRadius * kernelRadius;
+//    poly6Coef = (float)(315.0 / (64.0 * M_PI * pow(kernelRadius, 9)));
+//    spikyCoef = (float)(-45.0 / (M_PI * pow(kernelRadius, 6)));
+//    viscosityCoef = -spikyCoef;
+//
+//    particles.assign(count, Particle());
+//    accelerations.assign(count, Vec2());
+//    particleCell.assign(count, 0);
+//    cellParticles.assign(count, 0);
+//    gridCells = std::max(1, (int)ceilf(2 * BOUNDARY / kernelRadius));
+//    cellStart.assign((size_t)gridCells * gridCells + 1, 0);
+//    cellCursor.assign((size_t)gridCells * gridCells, 0);
+//    mortonKeys.assign(count, 0);
+//    mortonOrder.assign(count, 0);
+//    reorderScratch.assign(count, Particle());
+//}
+//
+//// Runs fn(begin, end) on every thread of the pool, one contiguous slice of [0, count) each
+//template <class Fn>
+//void parallelFor(int count, const Fn& fn) {
+//    if (!pool || pool->size() == 1) {
+//        fn(0, count);
+//        return;
+//    }
+//    pool->run([&](int thread, int threads) {
+//        fn((int)((long long)count * thread / threads), (int)((long long)count * (thread + 1) / threads));
+//    });
+//}
+//
+//// --- Neighbour grid ---
+//inline int cellCoord(float x) {
+//    int c = (int)((x + BOUNDARY) / kernelRadius);
+//    return std::min(std::max(c, 0), gridCells - 1);
+//}
+//
+//void buildGrid() {
+//    parallelFor(numParticles, [](int begin, int end) {
+//        for (int i = begin; i < end; ++i) {
+//            particleCell[i] = cellCoord(particles[i].pos.y) * gridCells + cellCoord(particles[i].pos.x);
+//        }
+//    });
+//
+//    // Counting sort: histogram, exclusive prefix sum, stable scatter
+//    std::fill(cellStart.begin(), cellStart.end(), 0);
+//    for (int i = 0; i < numParticles; ++i) cellStart[particleCell[i] + 1]++;
+//    for (size_t c = 1; c < cellStart.size(); ++c) cellStart[c] += cellStart[c - 1];
+//    std::copy(cellStart.begin(), cellStart.end() - 1, cellCursor.begin());
+//    for (int i = 0; i < numParticles; ++i) cellParticles[cellCursor[particleCell[i]]++] = i;
+//}
+//
+//// Calls fn(j) for every particle j in the 3x3 cells around particle i. The three
+//// cells of one grid row are adjacent in cellParticles, so each row is a single range.
+//template <class Fn>
+//inline void forEachNeighbour(int i, const Fn& fn) {
+//    int cell = particleCell[i];
+//    int cy = cell / gridCells, cx = cell - cy * gridCells;
+//    int x0 = std::max(cx - 1, 0), x1 = std::min(cx + 1, gridCells - 1);
+//    int y1 = std::min(cy + 1, gridCells - 1);
+//    for (int y = std::max(cy - 1, 0); y <= y1; ++y) {
+//        const int row = y * gridCells;
+//        for (int k = cellStart[row + x0], end = cellStart[row + x1 + 1]; k < end; ++k) {
+//            fn(cellParticles[k]);
+//        }
+//    }
+//}
+//
+//// --- Morton reorder ---
+//// Interleaves the low 16 bits of x (even bits) and y (odd bits)
+//inline uint32_t mortonCode(uint32_t x, uint32_t y) {
+//    auto spread = [](uint32_t v) {
+//        v &= 0xFFFF;
+//        v = (v | (v << 8)) & 0x00FF00FF;
+//        v = (v | (v << 4)) & 0x0F0F0F0F;
+//        v = (v | (v << 2)) & 0x33333333;
+//        v = (v | (v << 1)) & 0x55555555;
+//        return v;
+//    };
+//    return spread(x) | (spread(y) << 1);
 //}
 //
-//Vec2 spikyGradient(float r, float h, const Vec2& dir) {
-//    if (r == 0 || r >= h) return Vec2(0, 0);
-//    float tmp = h - r;
-//    float grad = -45.0f / (M_PI * powf(h, 6)) * tmp * tmp;
-//    return dir * grad;
+//// Stable, so particles keep their relative order within a cell
+//void reorderParticles() {
+//    int bits = 1;
+//    while ((1 << bits) < gridCells) bits++;
+//    parallelFor(numParticles, [](int begin, int end) {
+//        for (int i = begin; i < end; ++i) {
+//            mortonKeys[i] = mortonCode(cellCoord(particles[i].pos.x), cellCoord(particles[i].pos.y));
+//            mortonOrder[i] = i;
+//        }
+//    });
+//    radixSorter.sort(mortonKeys.data(), mortonOrder.data(), numParticles, 2 * bits, pool.get());
+//    parallelFor(numParticles, [](int begin, int end) {
+//        for (int i = begin; i < end; ++i) reorderScratch[i] = particles[mortonOrder[i]];
+//    });
+//    particles.swap(reorderScratch);
+//}
+//
+//inline bool reorderDue() {
+//    return reorderInterval > 0 && stepCount % reorderInterval == 0;
 //}
 //
 //// --- Physics ---
 //void computeDensityPressure() {
-//    for (int i = 0; i < NUM_PARTICLES; ++i) {
-//        float sum = 0.0f;
-//        for (int j = 0; j < NUM_PARTICLES; ++j) {
-//            float r = (particles[i].pos - particles[j].pos).length();
-//            sum += PARTICLE_MASS * poly6(r, KERNEL_RADIUS);
+//    parallelFor(numParticles, [](int begin, int end) {
+//        for (int i = begin; i < end; ++i) {
+//            const Vec2 pos = particles[i].pos;
+//            float sum = 0.0f;
+//            forEachNeighbour(i, [&](int j) {
+//                float r2 = (pos - particles[j].pos).lengthSquared();
+//                if (r2 < kernelRadius2) sum += particleMass * poly6(r2);
+//            });
+//            particles[i].density = sum;
+//            particles[i].pressure = GAS_STIFFNESS * (particles[i].density - REST_DENSITY);
 //        }
-//        particles[i].density = sum;
-//        particles[i].pressure = GAS_STIFFNESS * (particles[i].density - REST_DENSITY);
-//    }
+//    });
 //}
 //
+//// Accelerations only: positions stay fixed until every particle has seen them
 //void computeForces() {
-//    for (int i = 0; i < NUM_PARTICLES; ++i) {
-//        Vec2 f_pressure(0, 0);
-//        Vec2 f_viscosity(0, 0);
-//
-//        for (int j = 0; j < NUM_PARTICLES; ++j) {
-//            if (i == j) continue;
-//            Vec2 rij = particles[i].pos - particles[j].pos;
-//            float r = rij.length();
+//    parallelFor(numParticles, [](int begin, int end) {
+//        for (int i = begin; i < end; ++i) {
+//            const Particle& pi = particles[i];
+//            const float pressureTerm = pi.pressure / (pi.density * pi.density);
+//            Vec2 f_pressure(0, 0);
+//            Vec2 f_viscosity(0, 0);
+//
+//            forEachNeighbour(i, [&](int j) {
+//                if (i == j) return;
+//                const Particle& pj = particles[j];
+//                Vec2 rij = pi.pos - pj.pos;
+//                float r2 = rij.lengthSquared();
+//                if (r2 >= kernelRadius2) return;
+//                float r = sqrtf(r2);
 //
-//            if (r < KERNEL_RADIUS) {
 //                // Pressure force
-//                Vec2 grad = spikyGradient(r, KERNEL_RADIUS, rij);
-//                float coef = -PARTICLE_MASS * (
-//                    particles[i].pressure / (particles[i].density * particles[i].density) +
-//                    particles[j].pressure / (particles[j].density * particles[j].density)
-//                    );
+//                Vec2 grad = spikyGradient(r, rij);
+//                float coef = -particleMass * (pressureTerm + pj.pressure / (pj.density * pj.density));
 //                f_pressure = f_pressure + grad * coef;
 //
 //                // Viscosity
-//                Vec2 laplacian = (particles[j].vel - particles[i].vel) *
-//                    (45.0f / (M_PI * powf(KERNEL_RADIUS, 6))) * (KERNEL_RADIUS - r);
-//                f_viscosity = f_viscosity + laplacian * VISCOSITY * PARTICLE_MASS / particles[j].density;
+//                Vec2 laplacian = (pj.vel - pi.vel) * (viscosityCoef * (kernelRadius - r));
+//                f_viscosity = f_viscosity + laplacian * (VISCOSITY * particleMass / pj.density);
+//            });
+//
+//            // Gravity
+//            Vec2 f_gravity(0, -GRAVITY * particleMass);
+//
+//            // Total acceleration
+//            accelerations[i] = (f_pressure + f_viscosity + f_gravity) / pi.density;
+//        }
+//    });
+//}
+//
+//void integrate() {
+//    parallelFor(numParticles, [](int begin, int end) {
+//        for (int i = begin; i < end; ++i) {
+//            Particle& p = particles[i];
+//
+//            // Update velocity and position (Euler)
+//            p.vel = p.vel + accelerations[i] * timeStep;
+//            p.pos = p.pos + p.vel * timeStep;
+//
+//            // Boundary handling (simple bounce)
+//            if (p.pos.x < -BOUNDARY) {
+//                p.pos.x = -BOUNDARY;
+//                p.vel.x *= -0.5f;
+//            }
+//            if (p.pos.x > BOUNDARY) {
+//                p.pos.x = BOUNDARY;
+//                p.vel.x *= -0.5f;
+//            }
+//            if (p.pos.y < -BOUNDARY) {
+//                p.pos.y = -BOUNDARY;
+//                p.vel.y *= -0.5f;
+//            }
+//            if (p.pos.y > BOUNDARY) {
+//                p.pos.y = BOUNDARY;
+//                p.vel.y *= -0.5f;
 //            }
 //        }
+//    });
+//}
+//
+//void simulationStep() {
+//    if (reorderDue()) reorderParticles();
+//    buildGrid();
+//    computeDensityPressure();
+//    computeForces();
+//    integrate();
+//    stepCount++;
+//}
 //
-//        // Gravity
-//        Vec2 f_gravity(0, -GRAVITY * PARTICLE_MASS);
+//// --- Init ---
+//// A dam block of rows across [-0.3, 0.3] stacked up from y = -0.4
+//void initParticles() {
+//    int columns = (int)(0.6f / particleSpacing + 0.5f) + 1;
+//    for (int i = 0; i < numParticles; ++i) {
+//        particles[i].pos = Vec2(-0.3f + (i % columns) * particleSpacing, -0.4f + (i / columns) * particleSpacing);
+//        particles[i].vel = Vec2(0, 0);
+//    }
+//}
 //
-//        // Total acceleration
-//        Vec2 acc = (f_pressure + f_viscosity + f_gravity) / particles[i].density;
+//// --- Headless benchmark ---
+//// All-pairs density of particle i, the O(N) reference for the grid lookup
+//float bruteForceDensity(int i) {
+//    float sum = 0.0f;
+//    for (int j = 0; j < numParticles; ++j) {
+//        float r2 = (particles[i].pos - particles[j].pos).lengthSquared();
+//        if (r2 < kernelRadius2) sum += particleMass * poly6(r2);
+//    }
+//    return sum;
+//}
 //
-//        // Update velocity and position (Euler)
-//        particles[i].vel = particles[i].vel + acc * DT;
-//        particles[i].pos = particles[i].pos + particles[i].vel * DT;
+//// A set-associative LRU model of one core's data cache. The real miss counters
+//// are not portable, and the particle loads are exactly what the reorder changes.
+//class CacheModel {
+//public:
+//    CacheModel(size_t bytes, int ways) : ways(ways), sets((int)(bytes / (LINE * ways))),
+//        tags((size_t)sets * ways, UINT64_MAX) {}
 //
-//        // Boundary handling (simple bounce)
-//        if (particles[i].pos.x < -BOUNDARY) {
-//            particles[i].pos.x = -BOUNDARY;
-//            particles[i].vel.x *= -0.5f;
-//        }
-//        if (particles[i].pos.x > BOUNDARY) {
-//            particles[i].pos.x = BOUNDARY;
-//            particles[i].vel.x *= -0.5f;
-//        }
-//        if (particles[i].pos.y < -BOUNDARY) {
-//            particles[i].pos.y = -BOUNDARY;
-//            particles[i].vel.y *= -0.5f;
-//        }
-//        if (particles[i].pos.y > BOUNDARY) {
-//            particles[i].pos.y = BOUNDARY;
-//            particles[i].vel.y *= -0.5f;
+//    void load(size_t address, size_t size) {
+//        for (uint64_t line = address / LINE; line <= (address + size - 1) / LINE; ++line) access(line);
+//    }
+//    long long misses() const { return missCount; }
+//
+//private:
+//    static const size_t LINE = 64;
+//
+//    // Each set keeps its tags most recently used first
+//    void access(uint64_t line) {
+//        uint64_t* set = tags.data() + (size_t)(line % sets) * ways;
+//        int hit = 0;
+//        while (hit < ways && set[hit] != line) hit++;
+//        if (hit == ways) {
+//            missCount++;
+//            hit = ways - 1;
 //        }
+//        std::copy_backward(set, set + hit, set + hit + 1);
+//        set[0] = line;
+//    }
+//
+//    int ways, sets;
+//    std::vector<uint64_t> tags;
+//    long long missCount = 0;
+//};
+//
+//// Modelled misses per particle of one density pass in the current order; needs buildGrid()
+//double densityPassMisses(size_t cacheBytes) {
+//    CacheModel cache(cacheBytes, 8);
+//    for (int i = 0; i < numParticles; ++i) {
+//        cache.load(i * sizeof(Particle), sizeof(Particle));
+//        forEachNeighbour(i, [&](int j) { cache.load(j * sizeof(Particle), sizeof(Particle)); });
 //    }
+//    return (double)cache.misses() / numParticles;
 //}
 //
-//// --- Init ---
-//void initParticles() {
-//    float spacing = 0.02f;
-//    int count = 0;
-//    for (float y = -0.4f; y <= -0.1f; y += spacing) {
-//        for (float x = -0.3f; x <= 0.3f && count < NUM_PARTICLES; x += spacing) {
-//            particles[count].pos = Vec2(x, y);
-//            particles[count].vel = Vec2(0, 0);
-//            count++;
+//struct OrderStats {
+//    double l1Misses, l2Misses, ms;
+//};
+//
+//// Rebuilds the grid for the current order and measures the density and force passes
+//OrderStats measureOrder() {
+//    buildGrid();
+//    OrderStats stats;
+//    stats.l1Misses = densityPassMisses(32 << 10);
+//    stats.l2Misses = densityPassMisses(1 << 20);
+//    const int repeats = 3;
+//    auto start = std::chrono::steady_clock::now();
+//    for (int r = 0; r < repeats; ++r) {
+//        computeDensityPressure();
+//        computeForces();
+//    }
+//    stats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repeats;
+//    return stats;
+//}
+//
+//// Compares the final state in its current order, in a random order (what emission
+//// order decays towards once the fluid has mixed) and freshly Morton sorted
+//void reportReorder(int reorders, double reorderMs) {
+//    OrderStats current = measureOrder();
+//    std::vector<Particle> saved = particles;
+//    std::shuffle(particles.begin(), particles.end(), std::mt19937(1));
+//    OrderStats shuffled = measureOrder();
+//    particles.swap(saved);
+//    auto start = std::chrono::steady_clock::now();
+//    reorderParticles();
+//    double sortMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+//    OrderStats morton = measureOrder();
+//    if (reorders > 0) sortMs = reorderMs / reorders;
+//
+//    auto reduction = [](double from, double to) { return from > 0 ? 100.0 * (1.0 - to / from) : 0.0; };
+//    std::cout << "[morton] " << (reorderInterval > 0 ? "reorder every " + std::to_string(reorderInterval) + " steps"
+//                                                  : std::string("reorder off")) << " (" << reorders << " in the run), "
+//              << sortMs << " ms per reorder, " << sortMs * 1e6 / numParticles << " ns/particle\n";
+//    std::cout << "[morton] density pass misses/particle in a modelled 32 KB L1: current " << current.l1Misses
+//              << ", shuffled " << shuffled.l1Misses << ", Morton " << morton.l1Misses << " ("
+//              << reduction(current.l1Misses, morton.l1Misses) << "% fewer than current, "
+//              << reduction(shuffled.l1Misses, morton.l1Misses) << "% fewer than shuffled)\n";
+//    std::cout << "[morton] 1 MB L2: current " << current.l2Misses << ", shuffled " << shuffled.l2Misses
+//              << ", Morton " << morton.l2Misses << " (" << reduction(current.l2Misses, morton.l2Misses)
+//              << "% / " << reduction(shuffled.l2Misses, morton.l2Misses) << "% fewer)\n";
+//    std::cout << "[morton] density + forces: current " << current.ms << " ms, shuffled " << shuffled.ms
+//              << " ms, Morton " << morton.ms << " ms\n";
+//}
+//
+//int runHeadlessBenchmark(int steps) {
+//    initParticles();
+//    double gridMs = 0.0, densityMs = 0.0, forcesMs = 0.0, integrateMs = 0.0, reorderMs = 0.0;
+//    int reorders = 0;
+//    auto ms = [](std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b) {
+//        return std::chrono::duration<double, std::milli>(b - a).count();
+//    };
+//    for (int s = 0; s < steps; ++s, ++stepCount) {
+//        if (reorderDue()) {
+//            auto t = std::chrono::steady_clock::now();
+//            reorderParticles();
+//            reorderMs += ms(t, std::chrono::steady_clock::now());
+//            reorders++;
 //        }
+//        auto t0 = std::chrono::steady_clock::now();
+//        buildGrid();
+//        auto t1 = std::chrono::steady_clock::now();
+//        computeDensityPressure();
+//        auto t2 = std::chrono::steady_clock::now();
+//        computeForces();
+//        auto t3 = std::chrono::steady_clock::now();
+//        integrate();
+//        auto t4 = std::chrono::steady_clock::now();
+//        gridMs += ms(t0, t1);
+//        densityMs += ms(t1, t2);
+//        forcesMs += ms(t2, t3);
+//        integrateMs += ms(t3, t4);
 //    }
-//    for (int i = count; i < NUM_PARTICLES; ++i) {
-//        particles[i].pos = Vec2(0, 0);
-//        particles[i].vel = Vec2(0, 0);
+//    double totalMs = gridMs + densityMs + forcesMs + integrateMs + reorderMs;
+//
+//    // Check the final state: neighbour counts, speed, and the grid density of a
+//    // few particles spread over the array against all pairs
+//    buildGrid();
+//    computeDensityPressure();
+//    long long neighbours = 0;
+//    float maxSpeed = 0.0f;
+//    for (int i = 0; i < numParticles; ++i) {
+//        forEachNeighbour(i, [&](int j) {
+//            if ((particles[i].pos - particles[j].pos).lengthSquared() < kernelRadius2) neighbours++;
+//        });
+//        maxSpeed = std::max(maxSpeed, particles[i].vel.length());
 //    }
+//    const int samples = std::min(numParticles, 64);
+//    float maxError = 0.0f;
+//    for (int k = 0; k < samples; ++k) {
+//        int i = (int)((long long)numParticles * k / samples);
+//        float reference = bruteForceDensity(i);
+//        maxError = std::max(maxError, fabsf(particles[i].density - reference) / reference);
+//    }
+//
+//    std::cout << "[bench] SPH " << numParticles << " particles, h " << kernelRadius << " (" << gridCells << "x"
+//              << gridCells << " cells), steps " << steps << ", threads " << (pool ? pool->size() : 1) << "\n";
+//    std::cout << "[bench] total " << totalMs << " ms, " << (steps > 0 ? totalMs / steps : 0.0)
+//              << " ms/step: grid " << gridMs / std::max(steps, 1) << ", density " << densityMs / std::max(steps, 1)
+//              << ", forces " << forcesMs / std::max(steps, 1) << ", integrate " << integrateMs / std::max(steps, 1)
+//              << ", reorder " << reorderMs / std::max(steps, 1) << "\n";
+//    std::cout << "[bench] " << (double)neighbours / numParticles << " neighbours/particle, max speed " << maxSpeed
+//              << " m/s, density vs all pairs on " << samples << " particles: max relative error " << maxError << "\n";
+//    reportReorder(reorders, reorderMs);
+//    return 0;
 //}
 //
 //// --- Rendering Setup ---
@@ -188,7 +531,7 @@
 //
 //    glBindVertexArray(VAO);
 //    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-//    glBufferData(GL_ARRAY_BUFFER, NUM_PARTICLES * sizeof(glm::vec2), nullptr, GL_DYNAMIC_DRAW);
+//    glBufferData(GL_ARRAY_BUFFER, numParticles * sizeof(glm::vec2), nullptr, GL_DYNAMIC_DRAW);
 //
 //    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)0);
 //    glEnableVertexAttribArray(0);
@@ -201,23 +544,46 @@
 //    glClear(GL_COLOR_BUFFER_BIT);
 //
 //    std::vector<glm::vec2> positions;
-//    positions.reserve(NUM_PARTICLES);
+//    positions.reserve(numParticles);
 //    for (const auto& p : particles) {
 //        positions.emplace_back(p.pos.x, p.pos.y);
 //    }
 //
 //    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-//    glBufferSubData(GL_ARRAY_BUFFER, 0, NUM_PARTICLES * sizeof(glm::vec2), positions.data());
+//    glBufferSubData(GL_ARRAY_BUFFER, 0, numParticles * sizeof(glm::vec2), positions.data());
 //
 //    glUseProgram(shaderProgram);
 //    glBindVertexArray(VAO);
-//    glDrawArrays(GL_POINTS, 0, NUM_PARTICLES);
+//    glDrawArrays(GL_POINTS, 0, numParticles);
 //    glBindVertexArray(0);
 //    glUseProgram(0);
 //}
 //
 //// --- Main ---
-//int main() {
+//// SPH.exe [--particles N] [--threads N] [--reorder STEPS] [--bench STEPS]
+//int main(int argc, char** argv) {
+//    SimConfig config;
+//    config.threads = SOLVER_THREADS;
+//    config.particles = DEFAULT_PARTICLES;
+//    config.reorder = REORDER_INTERVAL;
+//    if (!parseSimConfig(argc, argv, config)) return -1;
+//    int count = config.particles;
+//    if (count < 1 || count > MAX_PARTICLES) {
+//        std::cerr << "--particles must be between 1 and " << MAX_PARTICLES << "\n";
+//        return -1;
+//    }
+//    if (config.reorder < 0) {
+//        std::cerr << "--reorder must be >= 0\n";
+//        return -1;
+//    }
+//    setResolution(count);
+//    reorderInterval = config.reorder;
+//    pool.reset(new ThreadPool(config.threads));
+//
+//    if (config.benchSteps > 0) {
+//        return runHeadlessBenchmark(config.benchSteps);
+//    }
+//
 //    glfwInit();
 //    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 //    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -246,8 +612,7 @@
 //    setupVAO();
 //
 //    while (!glfwWindowShouldClose(window)) {
-//        computeDensityPressure();
-//        computeForces();
+//        simulationStep();
 //
 //        render();
 //
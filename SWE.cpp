@@ -2,7 +2,7 @@
 //// ǳˮ棨CPU 汾+ ִ OpenGL Ⱦⲿļ
 //// GLFW, GLAD, OpenGL 3.3 Core
 //// 루VS2022
-//// cl /EHsc /std:c++17 /I"glfw/include" /I"glad/include" SWE.cpp /link glfw3.lib opengl32.lib
+//// cl /EHsc /std:c++17 /I"glfw/include" /I"glad/include" SWE.cpp wave_solver.cpp stencil_kernels.cpp thread_pool.cpp sim_config.cpp height_pack.cpp /link glfw3.lib opengl32.lib
 //
 //#include <iostream>
 //#include <vector>
@@ -13,30 +13,38 @@
 //#include <GLFW/glfw3.h>
 //#include <glad/glad.h>
 //
+//#include "wave_solver.h"
+//#include "stencil_kernels.h"
+//#include "thread_pool.h"
+//#include "sim_config.h"
+//#include "height_pack.h"
+//
 //// -------------------------------
 //// ˮģ
 //// -------------------------------
-//const int GRID_WIDTH = 256;
-//const int GRID_HEIGHT = 256;
+//const int DEFAULT_GRID_SIZE = 256; // ĬϷֱʣ --size WxH  --config 
 //const float DX = 1.0f;          // ռ䲽
 //const float DT = 0.016f;        // ʱ䲽 (~60 FPS)
 //const float GRAVITY = 9.81f;
 //const float BASE_DEPTH = 1.0f;
 //const float WAVE_SPEED = std::sqrt(GRAVITY * BASE_DEPTH);
-//const float R = (WAVE_SPEED * DT) / DX;
+//const int SUBSTEPS = 4;         // ÿ֡ӲR Ӳ㣬ȶ
+//const float R = (WAVE_SPEED * DT / SUBSTEPS) / DX;
 //const float R_SQ = R * R;
 //
+//const int SOLVER_THREADS = 0;   // ߳0 ʾʹȫӲ߳
+//
 //static_assert(R <= 0.5f, "Time step too large! Simulation will be unstable.");
 //
 //// -------------------------------
 //// ˮࣨCPU
 //// -------------------------------
+////  Neumann ߽ɹ WaveSolver ɣں˼ stencil_kernels.h CPUID ѡ SIMD 汾
 //class WaterSimulator {
 //public:
-//    WaterSimulator(int w, int h) : width(w), height(h) {
-//        prev.assign(width * height, 0.0f);
-//        curr.assign(width * height, 0.0f);
-//        next.assign(width * height, 0.0f);
+//    WaterSimulator(int w, int h)
+//        : width(w), height(h), solver(w, h, R_SQ, 1.0f, WaveBoundary::Neumann) {
+//        float* curr = solver.mutableData();
 //
 //        int cx = width / 2;
 //        int cy = height / 2;
@@ -48,44 +56,27 @@
 //                float dist = std::sqrt(dx * dx + dy * dy);
 //                if (dist < radius) {
 //                    float weight = 1.0f - (dist / radius);
-//                    curr[j * width + i] = -0.5f * weight * weight;
+//                    curr[j * solver.stride() + i] = -0.5f * weight * weight;
 //                }
 //            }
 //        }
-//        prev = curr;
+//        std::copy(curr, curr + size_t(solver.stride()) * height, solver.previousData());
 //    }
 //
-//    void step() {
-//        for (int j = 1; j < height - 1; ++j) {
-//            for (int i = 1; i < width - 1; ++i) {
-//                float lap = curr[(j - 1) * width + i] +
-//                    curr[(j + 1) * width + i] +
-//                    curr[j * width + i - 1] +
-//                    curr[j * width + i + 1] -
-//                    4.0f * curr[j * width + i];
-//                next[j * width + i] = 2.0f * curr[j * width + i] - prev[j * width + i] + R_SQ * lap;
-//            }
-//        }
+//    void step() { solver.step(); } // Ϊ 1Neumann ߽磨
+//    void advance(int substeps) { solver.advance(substeps); }
+//    void setThreadPool(ThreadPool* pool) { solver.setThreadPool(pool); } // ߳ƽ
+//    // ÿСķֿƽ substeps prev/curr/next ÿֻ֡һڴ
+//    void setTemporalBlocking(int substeps) { solver.setTemporalBlocking(substeps); }
+//    // ϡģʽֻƽвķֿ飨--sparseʼʱֻĵˮԶķֿڲǰ֮ǰ
+//    void setSparse(float epsilon) { solver.setSparse(epsilon); }
 //
-//        // Neumann ߽磨
-//        for (int i = 0; i < width; ++i) {
-//            next[i] = next[width + i];
-//            next[(height - 1) * width + i] = next[(height - 2) * width + i];
-//        }
-//        for (int j = 0; j < height; ++j) {
-//            next[j * width] = next[j * width + 1];
-//            next[j * width + width - 1] = next[j * width + width - 2];
-//        }
-//
-//        prev.swap(curr);
-//        curr.swap(next);
-//    }
-//
-//    const std::vector<float>& getHeightField() const { return curr; }
+//    const float* getHeightField() const { return solver.data(); }
+//    int stride() const { return solver.stride(); } // ߶ȳпȣ䣩
 //
 //private:
 //    int width, height;
-//    std::vector<float> prev, curr, next;
+//    WaveSolver solver;
 //};
 //
 //// -------------------------------
@@ -135,8 +126,31 @@
 //// -------------------------------
 //// 
 //// -------------------------------
-//int main()
+//int main(int argc, char** argv)
 //{
+//    stencilFlushDenormals(); // ǹ 0 ģ
+//
+//    SimConfig config;
+//    config.width = config.height = DEFAULT_GRID_SIZE;
+//    config.threads = SOLVER_THREADS;
+//    if (!parseSimConfig(argc, argv, config)) {
+//        return -1;
+//    }
+//    const int gridWidth = config.width;
+//    const int gridHeight = config.height;
+//
+//    // ϴʽf32Ĭϣf16 뾫ȡq16 16 λ㣨һ߶ȱ [0,1]ֱӳ䵽 065535
+//    HeightFormat uploadFormat = HeightFormat::F32;
+//    if (!config.heightFormat.empty() && !parseHeightFormat(config.heightFormat.c_str(), uploadFormat)) {
+//        std::cerr << "Unknown --height_format " << config.heightFormat << "\n";
+//        return -1;
+//    }
+//    if (uploadFormat != HeightFormat::F32) {
+//        float bound = uploadFormat == HeightFormat::F16 ? halfErrorBound(1.0f) : unorm16ErrorBound(0.0f, 1.0f);
+//        std::cout << "Height upload " << heightFormatName(uploadFormat) << ", max error " << bound
+//                  << " (normalized height)\n";
+//    }
+//
 //    if (!glfwInit()) {
 //        std::cerr << "Failed to initialize GLFW\n";
 //        return -1;
@@ -164,10 +178,18 @@
 //    glViewport(0, 0, 800, 800);
 //
 //    // ʼˮģ
-//    WaterSimulator sim(GRID_WIDTH, GRID_HEIGHT);
-//
-//    // Ⱦ壨һ [0,1]
-//    std::vector<float> render_buffer(GRID_WIDTH * GRID_HEIGHT);
+//    WaterSimulator sim(gridWidth, gridHeight);
+//    ThreadPool solverPool(config.threads);
+//    sim.setThreadPool(&solverPool);
+//    sim.setTemporalBlocking(SUBSTEPS);
+//    sim.setSparse(config.sparse); // ʱֿ
+//
+//    // Ⱦ壨һ [0,1]ϴʱֻҪһ float ݴ棬ֱ֡д 16 λ
+//    std::vector<float> render_buffer(uploadFormat == HeightFormat::F32 ? size_t(gridWidth) * gridHeight : size_t(gridWidth));
+//    std::vector<uint16_t> packed_buffer(uploadFormat == HeightFormat::F32 ? 0 : size_t(gridWidth) * gridHeight);
+//    const GLenum uploadType = uploadFormat == HeightFormat::F16 ? GL_HALF_FLOAT
+//                            : uploadFormat == HeightFormat::Q16 ? GL_UNSIGNED_SHORT : GL_FLOAT;
+//    const void* uploadData = uploadFormat == HeightFormat::F32 ? (const void*)render_buffer.data() : (const void*)packed_buffer.data();
 //
 //    // ȫıΣΣ
 //    float quadVertices[] = {
@@ -191,7 +213,10 @@
 //    unsigned int texture;
 //    glGenTextures(1, &texture);
 //    glBindTexture(GL_TEXTURE_2D, texture);
-//    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, GRID_WIDTH, GRID_HEIGHT, 0, GL_RED, GL_FLOAT, nullptr);
+//    GLenum internalFormat = uploadFormat == HeightFormat::F16 ? GL_R16F
+//                          : uploadFormat == HeightFormat::Q16 ? GL_R16 : GL_R32F;
+//    glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // 16 λʽʱг 4 ı
+//    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, gridWidth, gridHeight, 0, GL_RED, uploadType, nullptr);
 //    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 //    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 //    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -206,18 +231,29 @@
 //
 //    while (!glfwWindowShouldClose(window))
 //    {
-//        // ģһ
-//        sim.step();
+//        // ģһ֡SUBSTEPS Ӳ
+//        sim.advance(SUBSTEPS);
 //
 //        // ׼Ⱦݣһ߶ȵ [0,1]
-//        const auto& h = sim.getHeightField();
-//        for (size_t i = 0; i < render_buffer.size(); ++i) {
-//            render_buffer[i] = std::clamp(h[i] * 0.5f + 0.5f, 0.0f, 1.0f);
+//        const float* h = sim.getHeightField();
+//        for (int j = 0; j < gridHeight; ++j) {
+//            const float* row = h + size_t(j) * sim.stride();
+//            float* dst = uploadFormat == HeightFormat::F32 ? render_buffer.data() + size_t(j) * gridWidth : render_buffer.data();
+//            for (int i = 0; i < gridWidth; ++i) {
+//                dst[i] = std::clamp(row[i] * 0.5f + 0.5f, 0.0f, 1.0f);
+//            }
+//            // һлڻʱתF16C / AVX2
+//            if (uploadFormat == HeightFormat::F16) {
+//                packHeightsHalf(packed_buffer.data() + size_t(j) * gridWidth, dst, gridWidth);
+//            }
+//            else if (uploadFormat == HeightFormat::Q16) {
+//                packHeightsUnorm16(packed_buffer.data() + size_t(j) * gridWidth, dst, gridWidth, 0.0f, 1.0f);
+//            }
 //        }
 //
 //        // 
 //        glBindTexture(GL_TEXTURE_2D, texture);
-//        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, GRID_WIDTH, GRID_HEIGHT, GL_RED, GL_FLOAT, render_buffer.data());
+//        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, gridWidth, gridHeight, GL_RED, uploadType, uploadData);
 //        glBindTexture(GL_TEXTURE_2D, 0);
 //
 //        // Ⱦ
@@ -0,0 +1,82 @@
+﻿// aligned_buffer.h
+// 64 字节（缓存行）对齐的堆上 float 缓冲区，以及把行跨度补齐到缓存行的 paddedStride()。
+// 每行都从缓存行开头开始，SIMD 访问不会因为行首错位多跨一条缓存行，多线程条带之间也不会伪共享。
+#pragma once
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+const size_t GRID_ALIGNMENT = 64;
+
+// 行跨度（float 个数）补齐到 64 字节的整数倍
+constexpr int paddedStride(int width) {
+    const int floatsPerLine = int(GRID_ALIGNMENT / sizeof(float));
+    return (width + floatsPerLine - 1) / floatsPerLine * floatsPerLine;
+}
+
+class AlignedBuffer {
+public:
+    AlignedBuffer() = default;
+    explicit AlignedBuffer(size_t count) { allocate(count); }
+    ~AlignedBuffer() { release(); }
+
+    AlignedBuffer(const AlignedBuffer&) = delete;
+    AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+    AlignedBuffer(AlignedBuffer&& other) noexcept : ptr(other.ptr), count(other.count) {
+        other.ptr = nullptr;
+        other.count = 0;
+    }
+    AlignedBuffer& operator=(AlignedBuffer&& other) noexcept {
+        if (this != &other) {
+            release();
+            ptr = other.ptr;
+            count = other.count;
+            other.ptr = nullptr;
+            other.count = 0;
+        }
+        return *this;
+    }
+
+    // 重新分配 n 个 float 并清零（原内容丢弃）
+    void allocate(size_t n) {
+        release();
+        if (n == 0) return;
+        size_t bytes = (n * sizeof(float) + GRID_ALIGNMENT - 1) / GRID_ALIGNMENT * GRID_ALIGNMENT;
+#if defined(_MSC_VER)
+        ptr = static_cast<float*>(_aligned_malloc(bytes, GRID_ALIGNMENT));
+#else
+        void* p = nullptr;
+        ptr = posix_memalign(&p, GRID_ALIGNMENT, bytes) == 0 ? static_cast<float*>(p) : nullptr;
+#endif
+        if (!ptr) throw std::bad_alloc();
+        count = n;
+        std::memset(ptr, 0, bytes);
+    }
+
+    void zero() {
+        if (ptr) std::memset(ptr, 0, count * sizeof(float));
+    }
+
+    float* data() { return ptr; }
+    const float* data() const { return ptr; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+private:
+    void release() {
+#if defined(_MSC_VER)
+        _aligned_free(ptr);
+#else
+        std::free(ptr);
+#endif
+        ptr = nullptr;
+        count = 0;
+    }
+
+    float* ptr = nullptr;
+    size_t count = 0;
+};
@@ -0,0 +1,105 @@
+﻿// cdlod.cpp
+#include "cdlod.h"
+#include <algorithm>
+#include <cmath>
+
+// 形变从本层距离区间的 70% 处开始，到区间终点完成
+static const float MORPH_START_RATIO = 0.7f;
+
+CdlodFrustum CdlodFrustum::fromMatrix(const glm::mat4& m) {
+    // glm 按列存储：m[col][row]，取出各行
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    CdlodFrustum f;
+    f.planes[0] = row3 + row0; // 左
+    f.planes[1] = row3 - row0; // 右
+    f.planes[2] = row3 + row1; // 下
+    f.planes[3] = row3 - row1; // 上
+    f.planes[4] = row3 + row2; // 近
+    f.planes[5] = row3 - row2; // 远
+    for (glm::vec4& p : f.planes) {
+        p /= glm::length(glm::vec3(p));
+    }
+    return f;
+}
+
+bool CdlodFrustum::intersects(const glm::vec3& boxMin, const glm::vec3& boxMax) const {
+    for (const glm::vec4& p : planes) {
+        // 取包围盒在平面法线方向上最远的顶点，它都在平面外侧则整个盒子在外
+        glm::vec3 v(p.x >= 0.0f ? boxMax.x : boxMin.x,
+                    p.y >= 0.0f ? boxMax.y : boxMin.y,
+                    p.z >= 0.0f ? boxMax.z : boxMin.z);
+        if (p.x * v.x + p.y * v.y + p.z * v.z + p.w < 0.0f) return false;
+    }
+    return true;
+}
+
+void CdlodQuadtree::build(int w, int h, float s, int patchRes, float range0) {
+    width = w;
+    height = h;
+    spacing = s;
+    patch = patchRes;
+
+    // 根节点要盖住全部 (W−1)×(H−1) 个格子
+    int quads = std::max(w - 1, h - 1);
+    levelCount = 1;
+    rootSize = patch;
+    while (rootSize < quads && levelCount < MAX_LEVELS) {
+        rootSize *= 2;
+        ++levelCount;
+    }
+    // 范围至少是两个补丁边长：否则相邻节点的层级可能差 2 以上，形变接不上会出现裂缝
+    range0 = std::max(range0, 2.0f * patch * spacing);
+    for (int level = 0; level < MAX_LEVELS; ++level) {
+        ranges[level] = range0 * float(1 << level);
+    }
+}
+
+glm::vec2 CdlodQuadtree::morphRange(int level) const {
+    float lo = level > 0 ? ranges[level - 1] : 0.0f;
+    float end = ranges[level];
+    return glm::vec2(lo + (end - lo) * MORPH_START_RATIO, end);
+}
+
+// 球与轴对齐包围盒是否相交
+static bool sphereIntersectsBox(const glm::vec3& center, float radius, const glm::vec3& boxMin, const glm::vec3& boxMax) {
+    glm::vec3 nearest = glm::clamp(center, boxMin, boxMax);
+    glm::vec3 d = nearest - center;
+    return glm::dot(d, d) <= radius * radius;
+}
+
+void CdlodQuadtree::select(const glm::vec3& camera, const CdlodFrustum& frustum, float yMin, float yMax,
+                           std::vector<CdlodNode>& out) const {
+    out.clear();
+    selectNode(0, 0, rootSize, levelCount - 1, camera, frustum, yMin, yMax, out);
+}
+
+void CdlodQuadtree::selectNode(int x, int z, int size, int level, const glm::vec3& camera, const CdlodFrustum& frustum,
+                               float yMin, float yMax, std::vector<CdlodNode>& out) const {
+    if (x >= width - 1 || z >= height - 1) return; // 根节点按 2 的幂取整，超出网格的部分没有内容
+
+    glm::vec3 boxMin((x - width / 2.0f) * spacing, yMin, (z - height / 2.0f) * spacing);
+    glm::vec3 boxMax((std::min(x + size, width - 1) - width / 2.0f) * spacing, yMax,
+                     (std::min(z + size, height - 1) - height / 2.0f) * spacing);
+    if (!frustum.intersects(boxMin, boxMax)) return;
+
+    // 节点任何部分落在下一层的范围内就细分，否则整块用本层绘制。
+    // 这样相邻节点的层级最多差 1，且粗节点的每个点都在细一层的范围之外，边界上的细顶点已完全形变
+    if (level == 0 || !sphereIntersectsBox(camera, ranges[level - 1], boxMin, boxMax)) {
+        out.push_back({ x, z, size, level });
+        return;
+    }
+    int half = size / 2;
+    selectNode(x, z, half, level - 1, camera, frustum, yMin, yMax, out);
+    selectNode(x + half, z, half, level - 1, camera, frustum, yMin, yMax, out);
+    selectNode(x, z + half, half, level - 1, camera, frustum, yMin, yMax, out);
+    selectNode(x + half, z + half, half, level - 1, camera, frustum, yMin, yMax, out);
+}
+
+float cdlodRangeForScreen(int viewportHeight, float fovY, float spacing, float targetPixels) {
+    float pixelsPerUnit = viewportHeight / (2.0f * std::tan(fovY * 0.5f)); // 距离 1 处每单位长度的像素数
+    return spacing * pixelsPerUnit / targetPixels;
+}
@@ -0,0 +1,57 @@
+﻿// cdlod.h
+// 大水面的连续距离 LOD（CDLOD，Strugar 2009）：网格按四叉树分块，每个节点都用同一块 PATCH_RES×PATCH_RES 的补丁网格绘制，
+// 层级越高节点越大、采样越稀疏。按摄像机到节点包围盒的距离选层级，视锥体外的节点在 CPU 上剔除；
+// 相邻层级之间的过渡在顶点着色器里完成：靠近本层范围外缘的奇数顶点逐渐并到偶数顶点上，和上一层的网格严丝合缝，没有裂缝也没有跳变。
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+// 视锥体：从 projection * view 矩阵提取 6 个平面（Gribb-Hartmann），法线朝内
+struct CdlodFrustum {
+    glm::vec4 planes[6];
+
+    static CdlodFrustum fromMatrix(const glm::mat4& viewProjection);
+    // 轴对齐包围盒是否（可能）与视锥体相交；保守判断，只会多画不会漏画
+    bool intersects(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+};
+
+// 选出的一个节点：覆盖网格坐标 [x, x + size] × [z, z + size]（单位为格子），用第 level 层的补丁绘制
+struct CdlodNode {
+    int x, z;
+    int size;
+    int level;
+};
+
+class CdlodQuadtree {
+public:
+    static const int MAX_LEVELS = 16;
+
+    // 宽 width、高 height 个顶点的网格，格子间距 spacing，以网格中心为原点（与 initGrid() 一致）。
+    // patchRes 为补丁每边的格子数（必须是偶数）；range0 为第 0 层的 LOD 距离，之后每层翻倍
+    void build(int width, int height, float spacing, int patchRes, float range0);
+
+    int levels() const { return levelCount; }
+    int patchRes() const { return patch; }
+    float range(int level) const { return ranges[level]; }
+    // 第 level 层的形变区间 (起点, 终点)：距离超过终点时顶点完全并到上一层的网格上
+    glm::vec2 morphRange(int level) const;
+
+    // 选出本帧要画的节点（追加到 out 之前先清空）。yMin / yMax 为水面高度（世界坐标）的范围，决定节点包围盒的高度
+    void select(const glm::vec3& camera, const CdlodFrustum& frustum, float yMin, float yMax,
+                std::vector<CdlodNode>& out) const;
+
+private:
+    void selectNode(int x, int z, int size, int level, const glm::vec3& camera, const CdlodFrustum& frustum,
+                    float yMin, float yMax, std::vector<CdlodNode>& out) const;
+
+    int width = 0, height = 0;
+    float spacing = 1.0f;
+    int patch = 32;
+    int levelCount = 1;
+    int rootSize = 32; // 根节点边长（格子数），patch << (levelCount - 1)
+    float ranges[MAX_LEVELS] = {};
+};
+
+// 屏幕分辨率决定的第 0 层 LOD 距离：在该距离上一个格子（spacing）投影到屏幕上约 targetPixels 像素高。
+// 之后每层距离翻倍、格子也翻倍，所以所有层级的格子在屏幕上大小相近，三角形数量跟随分辨率而不是网格大小
+float cdlodRangeForScreen(int viewportHeight, float fovY, float spacing, float targetPixels);
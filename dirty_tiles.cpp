@@ -0,0 +1,106 @@
+﻿// dirty_tiles.cpp
+#include "dirty_tiles.h"
+#include "height_pack.h"
+#include "thread_pool.h"
+#include <algorithm>
+
+void DirtyTiles::resize(int w, int h, int tileSize) {
+    width = w;
+    height = h;
+    tile = tileSize;
+    tilesX = (w + tile - 1) / tile;
+    tilesZ = (h + tile - 1) / tile;
+    snapshot.assign(size_t(w) * h, 0.0f);
+    flags.assign(size_t(tilesX) * tilesZ, 0);
+    tileMax.assign(size_t(tilesX) * tilesZ, 0.0f);
+    dirtyRects.clear();
+    forceAll = true;
+}
+
+void DirtyTiles::markAll() {
+    forceAll = true;
+}
+
+int DirtyTiles::update(const float* heights, int stride, float threshold, ThreadPool* pool) {
+    const int threads = pool ? pool->size() : 1;
+    std::vector<int> partialDirty(threads, 0);
+
+    auto tileRows = [&](int t, int n) {
+        for (int tz = tilesZ * t / n; tz < tilesZ * (t + 1) / n; ++tz) {
+            int z0 = tz * tile, z1 = std::min(z0 + tile, height);
+            for (int tx = 0; tx < tilesX; ++tx) {
+                int x0 = tx * tile, count = std::min(tile, width - x0);
+                float delta = 0.0f;
+                for (int z = z0; z < z1; ++z) {
+                    const float* src = heights + size_t(z) * stride + x0;
+                    delta = std::max(delta, maxAbsDelta(src, &snapshot[size_t(z) * width + x0], count));
+                }
+                bool isDirty = forceAll || delta > threshold;
+                flags[size_t(tz) * tilesX + tx] = isDirty;
+                if (!isDirty) continue;
+                ++partialDirty[t];
+                float m = 0.0f;
+                for (int z = z0; z < z1; ++z) {
+                    const float* src = heights + size_t(z) * stride + x0;
+                    std::copy(src, src + count, &snapshot[size_t(z) * width + x0]);
+                    m = std::max(m, ::maxAbsHeight(src, count));
+                }
+                tileMax[size_t(tz) * tilesX + tx] = m;
+            }
+        }
+    };
+    if (threads > 1) pool->run(tileRows);
+    else tileRows(0, 1);
+    forceAll = false;
+
+    dirty = 0;
+    for (int d : partialDirty) dirty += d;
+    maxAbs = *std::max_element(tileMax.begin(), tileMax.end());
+
+    // 合并成矩形：逐分块行找连续的脏块
+    dirtyRects.clear();
+    for (int tz = 0; tz < tilesZ; ++tz) {
+        int z0 = tz * tile, z1 = std::min(z0 + tile, height);
+        for (int tx = 0; tx < tilesX;) {
+            if (!flags[size_t(tz) * tilesX + tx]) {
+                ++tx;
+                continue;
+            }
+            int end = tx;
+            while (end < tilesX && flags[size_t(tz) * tilesX + end]) ++end;
+            DirtyRect rect = { tx * tile, z0, std::min(end * tile, width), z1 };
+            // 整行都脏并且紧接着上一个整行矩形：并成一块，上传时是一段连续内存
+            if (tx == 0 && end == tilesX && !dirtyRects.empty()) {
+                DirtyRect& last = dirtyRects.back();
+                if (last.x0 == 0 && last.x1 == width && last.z1 == z0) {
+                    last.z1 = z1;
+                    tx = end;
+                    continue;
+                }
+            }
+            dirtyRects.push_back(rect);
+            tx = end;
+        }
+    }
+    return dirty;
+}
+
+void DirtyTiles::refresh(const float* heights, int stride, const DirtyRect& rect) {
+    for (int z = rect.z0; z < rect.z1; ++z) {
+        const float* src = heights + size_t(z) * stride;
+        std::copy(src + rect.x0, src + rect.x1, &snapshot[size_t(z) * width + rect.x0]);
+    }
+    // 涉及到的分块重新统计快照的最大绝对值
+    for (int tz = rect.z0 / tile; tz <= (rect.z1 - 1) / tile; ++tz) {
+        int z0 = tz * tile, z1 = std::min(z0 + tile, height);
+        for (int tx = rect.x0 / tile; tx <= (rect.x1 - 1) / tile; ++tx) {
+            int x0 = tx * tile, count = std::min(tile, width - x0);
+            float m = 0.0f;
+            for (int z = z0; z < z1; ++z) {
+                m = std::max(m, ::maxAbsHeight(&snapshot[size_t(z) * width + x0], count));
+            }
+            tileMax[size_t(tz) * tilesX + tx] = m;
+        }
+    }
+    maxAbs = *std::max_element(tileMax.begin(), tileMax.end());
+}
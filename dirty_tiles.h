@@ -0,0 +1,44 @@
+﻿// dirty_tiles.h
+// 按分块跟踪上传后变化过的区域：保存上次上传时的高度快照，当前高度与快照的最大绝对差超过阈值的分块才算脏。
+// 只重新上传脏块，波纹衰减、水面平静下来的区域不再占用带宽；没上传的区域与真实高度的误差不超过阈值。
+#pragma once
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// 网格坐标下的矩形 [x0, x1) × [z0, z1)
+struct DirtyRect {
+    int x0, z0, x1, z1;
+};
+
+class DirtyTiles {
+public:
+    // 宽 width、高 height 个顶点的网格，分块边长 tileSize；之后第一次 update() 全部视为脏
+    void resize(int width, int height, int tileSize);
+    void markAll(); // 下一次 update() 全部视为脏
+
+    // 逐块比较 heights（行跨度 stride）与快照，脏块的快照更新为当前高度。有线程池时按分块行并行。返回脏块数
+    int update(const float* heights, int stride, float threshold, ThreadPool* pool);
+    // 把 rect 内的快照更新为当前高度。脏块以外的顶点也上传了时调用（例如 vertex 模式为法线多传的一圈），
+    // 否则这些顶点的快照与已上传的高度不一致，误差最多会累积到两倍阈值
+    void refresh(const float* heights, int stride, const DirtyRect& rect);
+
+    // 脏区：同一分块行里连续的脏块合并成一个矩形，整行都脏的相邻分块行再合并成一个矩形
+    const std::vector<DirtyRect>& rects() const { return dirtyRects; }
+    int dirtyCount() const { return dirty; }
+    int tileCount() const { return tilesX * tilesZ; }
+    float maxAbsHeight() const { return maxAbs; } // 快照（即已上传的高度）的最大绝对值
+
+private:
+    int width = 0, height = 0;
+    int tile = 32;
+    int tilesX = 0, tilesZ = 0;
+    std::vector<float> snapshot;  // 上次上传的高度，紧密排列 width × height
+    std::vector<uint8_t> flags;   // 每块一个字节，1 表示本次脏
+    std::vector<float> tileMax;   // 每块快照的最大绝对值，只在该块重新上传时更新
+    bool forceAll = true;
+    int dirty = 0;
+    float maxAbs = 0.0f;
+    std::vector<DirtyRect> dirtyRects;
+};
@@ -0,0 +1,56 @@
+﻿// disturbance_queue.cpp
+#include "disturbance_queue.h"
+#include <thread>
+
+DisturbanceQueue::DisturbanceQueue(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) size <<= 1;
+    mask = size - 1;
+    slots.reset(new Slot[size]);
+    for (size_t i = 0; i < size; ++i) {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+bool DisturbanceQueue::tryPush(const Disturbance& event) {
+    size_t pos = tail.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot& slot = slots[pos & mask];
+        ptrdiff_t diff = ptrdiff_t(slot.sequence.load(std::memory_order_acquire) - pos);
+        if (diff == 0) {
+            // 槽空着：抢占这个写位置，失败时 pos 被更新为最新的写位置，重试
+            if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                slot.event = event;
+                slot.sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (diff < 0) {
+            return false; // 消费者还没取走上一圈的事件：队列满
+        }
+        else {
+            pos = tail.load(std::memory_order_relaxed); // 其他生产者已经占用，换到新的写位置
+        }
+    }
+}
+
+void DisturbanceQueue::push(const Disturbance& event) {
+    while (!tryPush(event)) {
+        std::this_thread::yield();
+    }
+}
+
+size_t DisturbanceQueue::drain(std::vector<Disturbance>& out) {
+    size_t count = 0;
+    for (;;) {
+        Slot& slot = slots[head & mask];
+        if (slot.sequence.load(std::memory_order_acquire) != head + 1) {
+            break; // 还没发布（可能正在写）：留到下一次，保证按入队顺序取出
+        }
+        out.push_back(slot.event);
+        slot.sequence.store(head + mask + 1, std::memory_order_release); // 交还给下一圈的生产者
+        ++head;
+        ++count;
+    }
+    return count;
+}
@@ -0,0 +1,46 @@
+﻿// disturbance_queue.h
+// 扰动事件队列：多生产者（鼠标回调、脚本、雨滴发生器……任意线程）、单消费者（求解线程）的无锁有界环形缓冲区。
+// 每个事件带位置、半径、幅度和时间，消费者每步把到期的事件一次取走，交给 WaveSolver::splat() 批量叠加。
+// 与原来的单个 disturbX/disturbY 不同，两步之间到达的事件不会互相覆盖。
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// 一次扰动：在 (x, y)（网格坐标）处叠加高斯形状的冲击
+struct Disturbance {
+    float x, y;
+    float radius;    // 足迹半径（格子数），高斯 σ = radius / 3；<= 0 表示只加到最近的一个格子上
+    float amplitude; // 中心处叠加的高度
+    double time;     // 生效的模拟时间（秒）；不晚于当前模拟时间的事件在下一步生效
+};
+
+class DisturbanceQueue {
+public:
+    explicit DisturbanceQueue(size_t capacity = 1 << 16); // 容量向上取整到 2 的幂
+    DisturbanceQueue(const DisturbanceQueue&) = delete;
+    DisturbanceQueue& operator=(const DisturbanceQueue&) = delete;
+
+    // 生产者（任意线程）：队列满时 tryPush() 返回 false，push() 让出时间片直到有空位，不丢事件。
+    // 消费者线程自己不要在队列可能满时调用 push()
+    bool tryPush(const Disturbance& event);
+    void push(const Disturbance& event);
+
+    // 消费者（只能有一个线程）：把已经发布的事件按入队顺序追加到 out，返回取出的个数
+    size_t drain(std::vector<Disturbance>& out);
+
+    size_t capacity() const { return mask + 1; }
+
+private:
+    // 每个槽一个序号：等于写位置时可写，等于写位置 + 1 时已发布可读（Vyukov 有界队列）
+    struct Slot {
+        std::atomic<size_t> sequence;
+        Disturbance event;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> tail{ 0 }; // 生产者竞争的写位置
+    alignas(64) size_t head = 0;               // 只由消费者访问
+};
@@ -0,0 +1,126 @@
+﻿// fftw_cache.cpp
+#include "fftw_cache.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FFTW_CACHE_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace {
+
+int planThreads = 1;
+bool threadsInitialized = false;
+
+#ifdef FFTW_CACHE_X86
+void cpuid(unsigned regs[4], unsigned leaf) {
+#if defined(_MSC_VER)
+    int r[4];
+    __cpuid(r, int(leaf));
+    for (int i = 0; i < 4; ++i) regs[i] = unsigned(r[i]);
+#else
+    __cpuid(leaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+#endif
+
+} // namespace
+
+void fftwSetThreads(int threads) {
+    if (threads <= 0) {
+        threads = int(std::thread::hardware_concurrency());
+    }
+    if (!threadsInitialized) {
+        threadsInitialized = fftwf_init_threads() != 0;
+    }
+    planThreads = threadsInitialized ? std::max(threads, 1) : 1;
+    if (threadsInitialized) {
+        fftwf_plan_with_nthreads(planThreads);
+    }
+}
+
+int fftwThreads() {
+    return planThreads;
+}
+
+bool parseFftwRigor(const std::string& name, unsigned& rigor) {
+    if (name == "estimate") rigor = FFTW_ESTIMATE;
+    else if (name == "measure") rigor = FFTW_MEASURE;
+    else if (name == "patient") rigor = FFTW_PATIENT;
+    else return false;
+    return true;
+}
+
+std::string fftwCpuTag() {
+    std::string tag;
+#ifdef FFTW_CACHE_X86
+    unsigned regs[4];
+    cpuid(regs, 0x80000000u);
+    if (regs[0] >= 0x80000004u) {
+        char brand[49] = {};
+        for (unsigned leaf = 0; leaf < 3; ++leaf) {
+            cpuid(regs, 0x80000002u + leaf);
+            std::memcpy(brand + leaf * 16, regs, 16);
+        }
+        // 只保留字母和数字，其余连续字符合成一个 '-'
+        for (const char* c = brand; *c; ++c) {
+            bool alnum = (*c >= '0' && *c <= '9') || (*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z');
+            if (alnum) tag += *c;
+            else if (!tag.empty() && tag.back() != '-') tag += '-';
+        }
+        while (!tag.empty() && tag.back() == '-') tag.pop_back();
+    }
+    cpuid(regs, 1);
+    char signature[16];
+    std::snprintf(signature, sizeof(signature), "%s%08x", tag.empty() ? "" : "-", regs[0]); // family/model/stepping
+    tag += signature;
+#else
+    tag = "generic";
+#endif
+    return tag;
+}
+
+fftwf_plan fftwPlanCached(const std::string& key, unsigned rigor,
+                          const std::function<fftwf_plan(unsigned)>& make, FftwPlanInfo* info) {
+    fftwf_plan plan = nullptr;
+    fftwPlansCached(key, rigor, [&](unsigned flags) {
+        plan = make(flags);
+        return plan != nullptr;
+    }, info);
+    return plan;
+}
+
+bool fftwPlansCached(const std::string& key, unsigned rigor,
+                     const std::function<bool(unsigned)>& make, FftwPlanInfo* info) {
+    auto start = std::chrono::steady_clock::now();
+    FftwPlanInfo result;
+    bool planned = false;
+    if (rigor == FFTW_ESTIMATE) {
+        planned = make(FFTW_ESTIMATE);
+    }
+    else {
+        result.path = "fftw_wisdom_" + key + "_" + fftwCpuTag() + "_t" + std::to_string(planThreads) + ".txt";
+        fftwf_import_wisdom_from_filename(result.path.c_str()); // 没有文件时失败，照常实测
+        planned = make(rigor | FFTW_WISDOM_ONLY);
+        result.fromCache = planned;
+        if (!planned) {
+            planned = make(rigor);
+            if (planned) {
+                fftwf_export_wisdom_to_filename(result.path.c_str());
+            }
+        }
+    }
+    result.planMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (info) {
+        *info = result;
+    }
+    return planned;
+}
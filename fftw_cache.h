@@ -0,0 +1,40 @@
+﻿// fftw_cache.h
+// FFTW 的公共设置：多线程计划和 wisdom 缓存。FFTW_MEASURE / FFTW_PATIENT 制定计划时要实际跑很多候选算法，
+// 大尺寸下启动要几秒；实测结果（wisdom）按变换尺寸、CPU 型号和线程数存进缓存文件，之后启动直接读入，计划瞬间完成。
+// 同一台机器换了 CPU 或线程数会得到不同的文件名，不会用上别的配置测出来的计划。
+#pragma once
+// packages 里的 libfftw 3.3.4 只带 x64 的库（libfftw.targets 只在 x64 下链接），32 位下链接不上
+#if defined(_MSC_VER) && !defined(_WIN64)
+#error "FFTW (ocean_fft / fftw_cache / stable_fluids --poisson fft) needs an x64 build: the bundled libfftw package ships only lib/x64"
+#endif
+#include <functional>
+#include <string>
+#include <fftw3.h>
+
+// 初始化 FFTW 多线程（第一次调用时）并让之后制定的计划使用 threads 个线程（<= 0 表示全部硬件线程）。
+// 必须在制定任何计划之前调用
+void fftwSetThreads(int threads);
+int fftwThreads();
+
+// 计划的严格程度：estimate / measure / patient，对应 FFTW_ESTIMATE / FFTW_MEASURE / FFTW_PATIENT。无法识别时返回 false
+bool parseFftwRigor(const std::string& name, unsigned& rigor);
+
+struct FftwPlanInfo {
+    double planMs = 0.0;   // 制定计划的耗时
+    bool fromCache = false; // 计划完全来自缓存的 wisdom
+    std::string path;       // 缓存文件（estimate 时为空）
+};
+
+// 按 rigor 制定计划：先读入 key 对应的缓存文件，只用 wisdom 制定（FFTW_WISDOM_ONLY），
+// 缓存里没有再实测，并把新的 wisdom 写回缓存。make(flags) 负责用给定标志调用 fftwf_plan_*。
+// key 描述这个变换（例如 "c2r-512x512x5"），只能包含文件名可用的字符。rigor 为 FFTW_ESTIMATE 时不读写缓存
+fftwf_plan fftwPlanCached(const std::string& key, unsigned rigor,
+                          const std::function<fftwf_plan(unsigned)>& make, FftwPlanInfo* info = nullptr);
+
+// 同上，但一个 key 下制定一组计划（同一尺寸的多个变换共用一个缓存文件）。make(flags) 制定全部计划，
+// 有任何一个失败时要销毁已制定的并返回 false；只有全部成功才算来自缓存，否则整组重新实测后写回一次
+bool fftwPlansCached(const std::string& key, unsigned rigor,
+                     const std::function<bool(unsigned)>& make, FftwPlanInfo* info = nullptr);
+
+// CPU 型号（CPUID 品牌字符串加 family/model/stepping），只含字母、数字和 '-'，用作缓存文件名的一部分
+std::string fftwCpuTag();
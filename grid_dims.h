@@ -0,0 +1,43 @@
+﻿// grid_dims.h
+// 网格尺寸的编译期 / 运行时两种表示，供模板内核和平流内核按尺寸特化。
+// 常用分辨率（GRID_FIXED_SIZES）实例化为 GridDims<W, H>，宽、高、行跨度都是编译期常量，
+// 地址计算折叠成立即数，内层循环次数已知，编译器可以整段展开；其他尺寸用 GridDims<0, 0> 在运行时读取。
+// 两种版本执行的运算完全相同，结果逐位一致。
+#pragma once
+#include "aligned_buffer.h"
+
+template <int W, int H>
+struct GridDims {
+    static constexpr int width() { return W; }
+    static constexpr int height() { return H; }
+    static constexpr int stride() { return paddedStride(W); } // 行跨度（float 个数）
+};
+
+// 运行时尺寸（任意大小的回退版本）
+template <>
+struct GridDims<0, 0> {
+    GridDims(int width, int height) : w(width), h(height), s(paddedStride(width)) {}
+    GridDims(int width, int height, int stride) : w(width), h(height), s(stride) {}
+    int width() const { return w; }
+    int height() const { return h; }
+    int stride() const { return s; }
+
+    int w, h, s;
+};
+
+typedef GridDims<0, 0> RuntimeGridDims;
+
+// 编译期特化的分辨率：128…4096 的 2 的幂（正方形网格），X(n) 对每个 n 展开一次
+#define GRID_FIXED_SIZES(X) X(128) X(256) X(512) X(1024) X(2048) X(4096)
+
+// 按尺寸选择版本并调用 fn(dims)：width × height 在 GRID_FIXED_SIZES 里时传 GridDims<W, H>，否则传运行时版本。
+// Border 是尺寸之外的边界格数：Stam 风格的 N×N 网格外面还有一圈边界，用 withGridDims<1>(N, N, fn)，
+// 得到的 dims 是 (N + 2) × (N + 2)
+template <int Border = 0, class Fn>
+void withGridDims(int width, int height, Fn&& fn) {
+#define GRID_DIMS_CASE(n) \
+    if (width == n && height == n) { fn(GridDims<n + 2 * Border, n + 2 * Border>()); return; }
+    GRID_FIXED_SIZES(GRID_DIMS_CASE)
+#undef GRID_DIMS_CASE
+    fn(RuntimeGridDims(width + 2 * Border, height + 2 * Border));
+}
@@ -7,6 +7,29 @@
 #include <iostream>
 #include <vector>
 #include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <random>
+#include <cstring>
+#include <cfloat>
+#include <atomic>
+#include <thread>
+#include "wave_solver.h"
+#include "stencil_kernels.h"
+#include "thread_pool.h"
+#include "sim_config.h"
+#include "stream_buffer.h"
+#include "height_pack.h"
+#include "mesh_indices.h"
+#include "cdlod.h"
+#include "dirty_tiles.h"
+#include "triple_buffer.h"
+#include "disturbance_queue.h"
+#include "height_pyramid.h"
+#include "ocean_fft.h"
 
 // 定义顶点结构
 struct Vertex {
@@ -14,9 +37,9 @@ struct Vertex {
     glm::vec3 Normal;
 };
 
-// 定义水面网格分辨率：128×128 个顶点
-const int GRID_WIDTH = 128;  // 网格宽度
-const int GRID_HEIGHT = 128; // 网格高度
+// 水面网格分辨率：默认 128×128 个顶点，运行时由 --size / 配置文件指定
+int gridWidth = 128;  // 网格宽度
+int gridHeight = 128; // 网格高度
 const float GRID_SIZE = 1.0f; // 每个格子的物理尺寸（米）,用于渲染和计算
 
 // 波动参数
@@ -24,12 +47,69 @@ const float DAMPING = 0.995f; // 阻尼系数,模拟能量损失.每帧对波浪
 const float WAVE_SPEED = 2.5f; // 波速,波在水面上传播的速度（单位：米/秒）
 const float TIME_STEP = 1.0f / 60.0f; // 时间步长,模拟帧率60FPS
 
-// 水面高度场
-float height[GRID_HEIGHT][GRID_WIDTH] = { 0 }; // 当前水面高度
-float prev_height[GRID_HEIGHT][GRID_WIDTH] = { 0 }; // 上一帧高度
+// 水面高度场：求解器内部保存 prev/curr/next 三个缓冲区，每步轮换
+const float C2_DT2_DX2 = (WAVE_SPEED * WAVE_SPEED * TIME_STEP * TIME_STEP) / (GRID_SIZE * GRID_SIZE);
+std::unique_ptr<WaveSolver> waveSolver; // 读完参数后按网格大小创建
+
+// 渲染方式
+enum class RenderMode {
+    Vertex, // 每帧上传完整顶点：位置 + 法线，24 字节/顶点
+    Height, // 每帧只上传高度，4 字节/顶点；位置由 gl_VertexID 重建，法线从缓冲区纹理取邻居高度计算
+    Texture, // 高度场整张作为 R32F/R16F 纹理上传，静态网格在顶点着色器里按纹理位移并计算法线
+    Cdlod,   // 同样上传高度纹理，但按四叉树分块、按距离选 LOD 并剔除视锥体外的块，见 cdlod.h
+    Patch    // 同样上传高度纹理，整个水面用一块 32×32 的补丁网格实例化绘制，没有整网格的索引缓冲
+};
+RenderMode renderMode = RenderMode::Vertex;
+const float HEIGHT_SCALE = 3.0f; // 渲染时放大高度以便观察
 
 // 渲染数据
-GLuint VAO, VBO, EBO; // 顶点数组对象（封装顶点属性），顶点缓冲对象（储存顶点位置），索引缓冲对象（存储三角形索引）
+GLuint VAO, EBO; // 顶点数组对象（封装顶点属性），索引缓冲对象（存储三角形索引）
+StreamBuffer vertexRing; // 顶点缓冲：三重缓冲的流式环形缓冲区，每帧直接写进映射出来的槽
+size_t vertexSlotOffset = 0; // 本帧写入的槽在 vertexRing 中的字节偏移
+GLuint heightTBO = 0; // RenderMode::Height：vertexRing 的缓冲区纹理视图，顶点着色器用它读邻居高度
+GLuint heightTexture = 0; // RenderMode::Texture：高度纹理（此模式下 vertexRing 用作像素解包缓冲区）
+GLuint meshVBO = 0;       // RenderMode::Texture：静态网格，每个顶点只有网格坐标；Cdlod / Patch：补丁网格
+GLsizei indexCount = 0;   // EBO 中的索引数
+// Cdlod / Patch：每个实例是补丁网格的一次摆放 (起点 x, 起点 z, 缩放 2^level, level)
+const int PATCH_RES = 32;       // 补丁每边的格子数
+GLuint instanceVBO = 0;
+GLsizei instanceCount = 0;
+// RenderMode::Cdlod：四叉树和本帧选出的节点
+const float CDLOD_TARGET_PIXELS = 4.0f; // 各层格子投影到屏幕上的目标大小（像素）
+CdlodQuadtree cdlodTree;
+std::vector<CdlodNode> cdlodNodes;
+float viewDistance = 100.0f; // 远裁剪面；cdlod 模式下放远到能看到整张网格
+float heightMaxAbs = 0.0f;   // 本帧高度的最大绝对值（未乘 HEIGHT_SCALE），决定 CDLOD 节点包围盒的高度
+// 脏区上传（--dirty_threshold > 0）：只重新上传高度变化超过阈值的分块，见 dirty_tiles.h
+const int DIRTY_TILE = 32;   // 分块边长（格子数）
+float dirtyThreshold = 0.0f;
+DirtyTiles dirtyTiles;
+
+// 拾取：射线对真实水面求交（height_pyramid.cpp）。金字塔跟随渲染使用的高度场 frameHeights：
+// 脏区上传时只增量更新脏区（放宽脏区阈值，和已上传的水面一致），否则整张都变了，标记过期，等下一次拾取时再重建
+HeightPyramid heightPyramid;
+bool pyramidStale = true;
+GLuint vertexVBO = 0;        // 脏区上传的 vertex 模式：普通顶点缓冲，按脏区 glBufferSubData（部分更新不能走多槽环形缓冲区）
+size_t uploadBytes = 0;      // 本帧上传的字节数
+// 高度上传格式（height / texture 模式）：f16 和 q16 在写入上传缓冲区时转换，上传量减半
+HeightFormat heightFormat = HeightFormat::F32;
+glm::vec2 heightDecode(1.0f, 0.0f); // 着色器解码：高度 = 存储值 * x + y（q16 每帧按实际范围更新）
+float heightErrorBound = 0.0f;      // 本帧量化误差上界（绝对值，未乘 HEIGHT_SCALE）
+GridIndexOrder indexOrder = GridIndexOrder::Stripes; // 三角形索引顺序，竖条顺序对顶点缓存友好
+
+// 各上传格式对应的 GL 纹理内部格式和像素 / 顶点属性类型
+struct HeightGLFormat {
+    GLenum internalFormat;
+    GLenum type;
+};
+
+HeightGLFormat heightGLFormat() {
+    switch (heightFormat) {
+    case HeightFormat::F16: return { GL_R16F, GL_HALF_FLOAT };
+    case HeightFormat::Q16: return { GL_R16, GL_UNSIGNED_SHORT }; // 归一化到 [0, 1]，着色器里按 heightDecode 还原
+    default:                return { GL_R32F, GL_FLOAT };
+    }
+}
 GLuint shaderProgram; // 着色器程序
 
 // 摄像机
@@ -44,8 +124,43 @@ float movementSpeed = 5.0f; // 摄像机移动速度
 float mouseSensitivity = 0.1f; // 鼠标灵敏度
 bool rightMousePressed = false; // 右键按下标志
 
-// 鼠标扰动位置
-int disturbX = -1, disturbY = -1; // 鼠标扰动位置，-1表示无扰动
+// 扰动事件：鼠标回调和其他输入源从任意线程入队，求解线程每步取出，到期的一次批量叠加（WaveSolver::splat）
+DisturbanceQueue disturbanceQueue;
+std::vector<Disturbance> pendingEvents; // 已经取出、还没到期的事件（只由求解线程访问）
+uint64_t solverStep = 0;                // updateWater() 推进的步数，模拟时间 = solverStep · TIME_STEP
+const float CLICK_RADIUS = 1.5f;        // 鼠标点击的高斯足迹半径（格子数）
+const float CLICK_AMPLITUDE = 0.2f;     // 扰动幅度
+
+// 雨（--rain）：每秒 rainRate 滴，按模拟时间换算成每步的滴数（小数部分留到下一步），和其他输入一样走扰动队列。
+// 位置、半径、幅度都取自固定种子的 mt19937，同一种子、同一速率的结果逐位可复现
+float rainRate = 0.0f;
+std::mt19937 rainRng;
+double rainCarry = 0.0;
+const float RAIN_RADIUS_MIN = 1.0f, RAIN_RADIUS_MAX = 3.0f;
+const float RAIN_AMPLITUDE = 0.02f; // 雨滴把水面往下压，幅度在 [-RAIN_AMPLITUDE, -RAIN_AMPLITUDE / 2] 之间
+uint32_t rainSeed = 1;
+int pickRays = 0; // --bench 时测试的拾取射线数（--picks）
+
+// 频谱海面（--ocean）：不走有限差分，每步由 OceanFft 按模拟时间直接合成整块周期海面，写进求解器的当前缓冲区，
+// 之后的快照、上传、拾取都照旧。海面边长等于网格边长（采样间距 GRID_SIZE），高度以米为单位，
+// 写入时除以 HEIGHT_SCALE，显示为真实比例。扰动和雨对它没有意义，事件取出后直接丢弃
+std::unique_ptr<OceanFft> ocean;
+std::string oceanSpectrum; // phillips / jonswap，只用于报告
+
+// 独立模拟线程（窗口模式默认开启，--sim_thread 0 关闭）：按固定时间步 TIME_STEP 推进，与渲染帧率无关，
+// 每推进完一批就把高度场复制进三重缓冲发布，渲染线程每帧取最新的一份，双方都不等待对方
+struct HeightSnapshot {
+    AlignedBuffer heights; // 与求解器相同的行跨度
+};
+TripleBuffer<HeightSnapshot> snapshots;
+std::thread simThread;
+std::atomic<bool> simRunning{ false };
+std::atomic<uint64_t> simSteps{ 0 };   // 模拟线程累计推进的步数
+std::atomic<uint64_t> simDropped{ 0 }; // 追不上实时而丢弃的步数
+const int MAX_STEPS_PER_TICK = 8;      // 一次最多补这么多步，追不上时丢弃积压的时间（放慢），不会越积越多
+
+// 渲染读取的高度场（行跨度同求解器）：串行时就是求解器的当前缓冲区，开启模拟线程时是最近取到的快照
+const float* frameHeights = nullptr;
 
 // --- Shader Sources ---
 // 顶点着色器
@@ -69,6 +184,153 @@ void main() {
 }
 )";
 
+// 只有高度的顶点着色器（RenderMode::Height）
+// 使用 glDrawElementsBaseVertex 时 gl_VertexID 已经包含 baseVertex，正好是这个顶点在整个环形缓冲区里的下标，
+// 邻居高度直接用 gl_VertexID ± 1 / ± gridSize.x 从同一块缓冲区的纹理视图里取
+const char* heightVertexShaderSource = R"(
+#version 330 core
+layout (location = 0) in float aHeight;
+
+uniform samplerBuffer heightBuffer; // 与顶点缓冲是同一块存储
+uniform ivec2 gridSize;             // 网格宽、高（顶点数）
+uniform int slotBase;               // 当前槽第一个顶点的下标（等于 baseVertex）
+uniform float gridSpacing;          // 格子物理尺寸
+uniform float heightScale;          // 高度放大倍数
+uniform vec2 heightDecode;          // 存储值 -> 高度：stored * x + y
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+out vec3 FragPos;
+out vec3 Normal;
+
+float heightAt(int index) {
+    return (texelFetch(heightBuffer, index).r * heightDecode.x + heightDecode.y) * heightScale;
+}
+
+void main() {
+    int local = gl_VertexID - slotBase;
+    int x = local % gridSize.x;
+    int z = local / gridSize.x;
+    vec3 pos = vec3((float(x) - float(gridSize.x) / 2.0) * gridSpacing,
+                    (aHeight * heightDecode.x + heightDecode.y) * heightScale,
+                    (float(z) - float(gridSize.y) / 2.0) * gridSpacing);
+
+    // 中心差分，与 CPU 版 updateVertexBuffer() 相同：边界顶点对应方向的斜率取 0
+    float dx = 0.0, dz = 0.0;
+    if (x > 0 && x < gridSize.x - 1)
+        dx = (heightAt(gl_VertexID - 1) - heightAt(gl_VertexID + 1)) / (2.0 * gridSpacing);
+    if (z > 0 && z < gridSize.y - 1)
+        dz = (heightAt(gl_VertexID - gridSize.x) - heightAt(gl_VertexID + gridSize.x)) / (2.0 * gridSpacing);
+
+    vec4 worldPos = model * vec4(pos, 1.0);
+    FragPos = worldPos.xyz;
+    Normal = mat3(transpose(inverse(model))) * normalize(vec3(-dx, 1.0, -dz));
+    gl_Position = projection * view * worldPos;
+}
+)";
+
+// 高度纹理的顶点着色器（RenderMode::Texture）：静态网格按高度纹理位移，法线由相邻纹素差分得到
+const char* textureVertexShaderSource = R"(
+#version 330 core
+layout (location = 0) in vec2 aGrid; // 网格坐标 (x, z)
+
+uniform sampler2D heightMap;
+uniform ivec2 gridSize;
+uniform float gridSpacing;
+uniform float heightScale;
+uniform vec2 heightDecode;           // 存储值 -> 高度：stored * x + y
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+out vec3 FragPos;
+out vec3 Normal;
+
+float heightAt(ivec2 texel) {
+    return (texelFetch(heightMap, texel, 0).r * heightDecode.x + heightDecode.y) * heightScale;
+}
+
+void main() {
+    ivec2 c = ivec2(aGrid);
+    vec3 pos = vec3((aGrid.x - float(gridSize.x) / 2.0) * gridSpacing,
+                    heightAt(c),
+                    (aGrid.y - float(gridSize.y) / 2.0) * gridSpacing);
+
+    // 中心差分，与 CPU 版 updateVertexBuffer() 相同：边界顶点对应方向的斜率取 0
+    float dx = 0.0, dz = 0.0;
+    if (c.x > 0 && c.x < gridSize.x - 1)
+        dx = (heightAt(c - ivec2(1, 0)) - heightAt(c + ivec2(1, 0))) / (2.0 * gridSpacing);
+    if (c.y > 0 && c.y < gridSize.y - 1)
+        dz = (heightAt(c - ivec2(0, 1)) - heightAt(c + ivec2(0, 1))) / (2.0 * gridSpacing);
+
+    vec4 worldPos = model * vec4(pos, 1.0);
+    FragPos = worldPos.xyz;
+    Normal = mat3(transpose(inverse(model))) * normalize(vec3(-dx, 1.0, -dz));
+    gl_Position = projection * view * worldPos;
+}
+)";
+
+// 补丁网格的顶点着色器（RenderMode::Cdlod / Patch）：同一块补丁网格按实例的起点和缩放摆放，高度双线性采样；
+// 离摄像机接近本层范围外缘时，奇数顶点逐渐并到偶数顶点上，到外缘时与粗一层的网格完全重合（Patch 模式不形变）
+const char* patchVertexShaderSource = R"(
+#version 330 core
+layout (location = 0) in vec2 aPatch; // 补丁内的格子坐标 0…patchRes
+layout (location = 1) in vec4 aNode;  // 每个实例：起点的网格坐标 (x, z)、补丁一格对应的网格格子数（2^level）、层级
+
+uniform sampler2D heightMap;
+uniform ivec2 gridSize;
+uniform float gridSpacing;
+uniform float heightScale;
+uniform vec2 heightDecode;           // 存储值 -> 高度：stored * x + y
+
+uniform vec2 morphRanges[16];        // 各层的形变区间（到摄像机的距离），见 CdlodQuadtree::morphRange()
+uniform vec3 cameraPos;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+out vec3 FragPos;
+out vec3 Normal;
+
+// t 为网格坐标（可以是小数）；超出网格的部分压到边上，对应的三角形退化为零面积
+float heightAt(vec2 t) {
+    vec2 uv = (clamp(t, vec2(0.0), vec2(gridSize - 1)) + 0.5) / vec2(gridSize);
+    return (texture(heightMap, uv).r * heightDecode.x + heightDecode.y) * heightScale;
+}
+
+vec3 worldAt(vec2 t) {
+    t = clamp(t, vec2(0.0), vec2(gridSize - 1));
+    return vec3((t.x - float(gridSize.x) / 2.0) * gridSpacing,
+                heightAt(t),
+                (t.y - float(gridSize.y) / 2.0) * gridSpacing);
+}
+
+void main() {
+    vec2 nodeOrigin = aNode.xy;
+    float nodeScale = aNode.z;
+    vec2 morphRange = morphRanges[int(aNode.w)];
+
+    // 形变系数按未形变的位置计算，相邻节点共享的顶点得到相同的结果
+    float dist = distance(worldAt(nodeOrigin + aPatch * nodeScale), cameraPos);
+    float morph = clamp((dist - morphRange.x) / (morphRange.y - morphRange.x), 0.0, 1.0);
+    vec2 t = nodeOrigin + (aPatch - mod(aPatch, 2.0) * morph) * nodeScale;
+    vec3 pos = worldAt(t);
+
+    // 中心差分，步长取本层的采样间距
+    float dx = (heightAt(t - vec2(nodeScale, 0.0)) - heightAt(t + vec2(nodeScale, 0.0))) / (2.0 * nodeScale * gridSpacing);
+    float dz = (heightAt(t - vec2(0.0, nodeScale)) - heightAt(t + vec2(0.0, nodeScale))) / (2.0 * nodeScale * gridSpacing);
+
+    vec4 worldPos = model * vec4(pos, 1.0);
+    FragPos = worldPos.xyz;
+    Normal = mat3(transpose(inverse(model))) * normalize(vec3(-dx, 1.0, -dz));
+    gl_Position = projection * view * worldPos;
+}
+)";
+
 // 片段着色器
 const char* fragmentShaderSource = R"(
 #version 330 core
@@ -102,9 +364,9 @@ void main() {
 
 // --- Shader Compilation ---
 // 着色器程序创建
-GLuint createShaderProgram() {
+GLuint createShaderProgram(const char* vertexSource) {
 	GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER); // 创建顶点着色器
-	glShaderSource(vertexShader, 1, &vertexShaderSource, NULL); // 设置着色器源码
+	glShaderSource(vertexShader, 1, &vertexSource, NULL); // 设置着色器源码
 	glCompileShader(vertexShader); // 编译顶点着色器
 
     GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
@@ -124,50 +386,185 @@ GLuint createShaderProgram() {
 // --- 初始化网格 ---
 #include <cstddef> // for offsetof
 
-// 初始化水面网格
-void initGrid() {
-	std::vector<Vertex> vertices;// 顶点数据
-	std::vector<unsigned int> indices; // 索引数据
+// 报告当前索引顺序的顶点缓存效率（ACMR），并与逐行顺序对比
+void reportIndexOrder(const std::vector<unsigned int>& indices) {
+    int vertexCount = gridWidth * gridHeight;
+    VertexCacheStats stats = simulateVertexCache(indices, vertexCount);
+    std::cout << "[mesh] index order " << (indexOrder == GridIndexOrder::Stripes ? "stripes" : "rows")
+              << ", ACMR " << stats.acmr << ", ATVR " << stats.atvr << " (FIFO 16)";
+    if (indexOrder != GridIndexOrder::Rows) {
+        VertexCacheStats rows = simulateVertexCache(buildGridIndices(gridWidth, gridHeight, GridIndexOrder::Rows), vertexCount);
+        std::cout << ", rows ACMR " << rows.acmr;
+    }
+    std::cout << "\n";
+}
 
-    // 生成顶点
-    for (int z = 0; z < GRID_HEIGHT; ++z) {
-        for (int x = 0; x < GRID_WIDTH; ++x) {
-            float worldX = (x - GRID_WIDTH / 2.0f) * GRID_SIZE;
-            float worldZ = (z - GRID_HEIGHT / 2.0f) * GRID_SIZE;
-			vertices.push_back({ glm::vec3(worldX, 0, worldZ), glm::vec3(0, 1, 0) }); // 初始法线向上
-        }
+// 高度纹理，每帧经由像素解包缓冲区（同样是三槽环形缓冲区）整张更新
+void initHeightTexture(bool allowPersistent, GLint filter) {
+    glGenTextures(1, &heightTexture);
+    glBindTexture(GL_TEXTURE_2D, heightTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    HeightGLFormat format = heightGLFormat();
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // 16 位格式奇数宽度时行长不是 4 的倍数
+    glTexImage2D(GL_TEXTURE_2D, 0, format.internalFormat, gridWidth, gridHeight, 0, GL_RED, format.type, NULL);
+    if (dirtyThreshold > 0.0f) {
+        // 脏区直接从内存按子矩形更新纹理，不需要解包缓冲区
+        std::cout << "[render] height texture " << heightFormatName(heightFormat) << ", dirty " << DIRTY_TILE << "x" << DIRTY_TILE
+                  << " tiles, threshold " << dirtyThreshold << "\n";
+        return;
     }
+    vertexRing.create(GL_PIXEL_UNPACK_BUFFER, size_t(gridWidth) * gridHeight * heightFormatBytes(heightFormat), allowPersistent);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    std::cout << "[render] height texture " << heightFormatName(heightFormat) << ", "
+              << (vertexRing.persistent() ? "persistent mapped PBO ring (3 slots)" : "orphaning PBO (GL 3.3 fallback)") << "\n";
+}
 
-    // 生成索引（三角形）
-    // 网格单元数量 = (W−1)×(H−1)
-    for (int z = 0; z < GRID_HEIGHT - 1; ++z) {
-        for (int x = 0; x < GRID_WIDTH - 1; ++x) {
-            unsigned int i = z * GRID_WIDTH + x;
-            indices.push_back(i);
-            indices.push_back(i + 1);
-            indices.push_back(i + GRID_WIDTH);
+// 按屏幕分辨率和网格大小建立 CDLOD 四叉树
+void buildCdlodTree(int viewportHeight) {
+    cdlodTree.build(gridWidth, gridHeight, GRID_SIZE, PATCH_RES,
+                    cdlodRangeForScreen(viewportHeight, glm::radians(45.0f), GRID_SIZE, CDLOD_TARGET_PIXELS));
+}
 
-            indices.push_back(i + 1);
-            indices.push_back(i + GRID_WIDTH + 1);
-            indices.push_back(i + GRID_WIDTH);
-        }
+// RenderMode::Patch：按补丁大小平铺整张网格，全部是第 0 层。最后一行 / 列的补丁超出网格的部分在着色器里压成零面积
+std::vector<glm::vec4> buildPatchInstances() {
+    std::vector<glm::vec4> instances;
+    for (int z = 0; z < gridHeight - 1; z += PATCH_RES)
+        for (int x = 0; x < gridWidth - 1; x += PATCH_RES)
+            instances.push_back(glm::vec4(float(x), float(z), 1.0f, 0.0f));
+    return instances;
+}
+
+// 报告补丁实例化相对整网格索引缓冲节省的索引内存和生成时间
+void reportPatchIndices() {
+    auto start = std::chrono::steady_clock::now();
+    size_t patchIndices = buildGridIndices(PATCH_RES + 1, PATCH_RES + 1, indexOrder).size();
+    auto mid = std::chrono::steady_clock::now();
+    size_t gridIndices = buildGridIndices(gridWidth, gridHeight, indexOrder).size();
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "[mesh] patch " << PATCH_RES << "x" << PATCH_RES << ": " << patchIndices * sizeof(unsigned int) / 1024.0
+              << " KB indices, " << std::chrono::duration<double, std::milli>(mid - start).count() << " ms, "
+              << buildPatchInstances().size() << " instances; full grid EBO "
+              << gridIndices * sizeof(unsigned int) / (1024.0 * 1024.0) << " MB, "
+              << std::chrono::duration<double, std::milli>(end - mid).count() << " ms\n";
+}
+
+// Cdlod / Patch：只有一块 (P+1)×(P+1) 个顶点的补丁网格，所有实例共用，与网格大小无关
+void initPatchMesh(bool allowPersistent) {
+    const int n = PATCH_RES + 1;
+    std::vector<unsigned int> indices = buildGridIndices(n, n, indexOrder);
+    indexCount = GLsizei(indices.size());
+    std::vector<glm::vec2> patchCoords;
+    patchCoords.reserve(size_t(n) * n);
+    for (int z = 0; z < n; ++z)
+        for (int x = 0; x < n; ++x)
+            patchCoords.push_back(glm::vec2(float(x), float(z)));
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &EBO);
+    glGenBuffers(1, &meshVBO);
+    glGenBuffers(1, &instanceVBO);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, meshVBO);
+    glBufferData(GL_ARRAY_BUFFER, patchCoords.size() * sizeof(glm::vec2), patchCoords.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    // 顶点属性 1：每个实例一个 vec4。Patch 模式上传一次；Cdlod 模式每帧按选出的节点重写
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    if (renderMode == RenderMode::Patch) {
+        std::vector<glm::vec4> instances = buildPatchInstances();
+        instanceCount = GLsizei(instances.size());
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(glm::vec4), instances.data(), GL_STATIC_DRAW);
     }
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+    glBindVertexArray(0);
+
+    // 形变后的顶点落在纹素之间，需要双线性采样（不形变时正好落在纹素中心，结果与最近点采样相同）
+    initHeightTexture(allowPersistent, GL_LINEAR);
+    if (renderMode == RenderMode::Cdlod) {
+        std::cout << "[render] cdlod " << PATCH_RES << "x" << PATCH_RES << " patch, "
+                  << cdlodTree.levels() << " levels, LOD0 range " << cdlodTree.range(0) << "\n";
+    }
+    else {
+        std::cout << "[render] " << PATCH_RES << "x" << PATCH_RES << " patch, " << instanceCount << " instances, "
+                  << indices.size() * sizeof(unsigned int) << " bytes of indices\n";
+    }
+}
+
+// 初始化水面网格（顶点每帧由 updateVertexBuffer() 写入，这里只生成索引）
+void initGrid(bool allowPersistent) {
+    if (renderMode == RenderMode::Cdlod || renderMode == RenderMode::Patch) {
+        initPatchMesh(allowPersistent);
+        return;
+    }
+
+    // 生成索引（三角形），网格单元数量 = (W−1)×(H−1)，顺序见 mesh_indices.h
+	std::vector<unsigned int> indices = buildGridIndices(gridWidth, gridHeight, indexOrder);
+    indexCount = GLsizei(indices.size());
+    reportIndexOrder(indices);
 
-    // 创建 VAO/VBO/EBO
+    // 创建 VAO/EBO
     glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
 
     glBindVertexArray(VAO);
 
-    // 绑定并上传顶点数据（Position + Normal）
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_DYNAMIC_DRAW);
-
     // 绑定索引缓冲
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
 
+    if (renderMode == RenderMode::Texture) {
+        // 静态网格：每个顶点只有网格坐标 (x, z)，上传一次，之后不再改动
+        std::vector<glm::vec2> gridCoords;
+        gridCoords.reserve(size_t(gridWidth) * gridHeight);
+        for (int z = 0; z < gridHeight; ++z)
+            for (int x = 0; x < gridWidth; ++x)
+                gridCoords.push_back(glm::vec2(float(x), float(z)));
+        glGenBuffers(1, &meshVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, meshVBO);
+        glBufferData(GL_ARRAY_BUFFER, gridCoords.size() * sizeof(glm::vec2), gridCoords.data(), GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)0);
+        glEnableVertexAttribArray(0);
+        glBindVertexArray(0);
+
+        initHeightTexture(allowPersistent, GL_NEAREST);
+        return;
+    }
+
+    // 顶点缓冲：每个槽放一整帧的顶点，绘制时用 baseVertex 选槽，属性指针不用改
+    size_t vertexBytes = renderMode == RenderMode::Height ? heightFormatBytes(heightFormat) : sizeof(Vertex);
+    if (dirtyThreshold > 0.0f) {
+        glGenBuffers(1, &vertexVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, vertexVBO);
+        glBufferData(GL_ARRAY_BUFFER, size_t(gridWidth) * gridHeight * vertexBytes, NULL, GL_DYNAMIC_DRAW);
+        std::cout << "[render] vertex buffer, dirty " << DIRTY_TILE << "x" << DIRTY_TILE << " tiles, threshold " << dirtyThreshold << "\n";
+    }
+    else {
+        vertexRing.create(GL_ARRAY_BUFFER, size_t(gridWidth) * gridHeight * vertexBytes, allowPersistent);
+        std::cout << "[render] vertex stream: " << vertexBytes << " bytes/vertex, "
+                  << (vertexRing.persistent() ? "persistent mapped ring (3 slots)" : "orphaning (GL 3.3 fallback)") << "\n";
+    }
+
+    if (renderMode == RenderMode::Height) {
+        // 顶点属性 0: 高度；同一块缓冲区再建一个同格式的缓冲区纹理，供顶点着色器读邻居
+        HeightGLFormat format = heightGLFormat();
+        GLboolean normalized = heightFormat == HeightFormat::Q16 ? GL_TRUE : GL_FALSE;
+        glVertexAttribPointer(0, 1, format.type, normalized, GLsizei(vertexBytes), (void*)0);
+        glEnableVertexAttribArray(0);
+        glGenTextures(1, &heightTBO);
+        glBindTexture(GL_TEXTURE_BUFFER, heightTBO);
+        glTexBuffer(GL_TEXTURE_BUFFER, format.internalFormat, vertexRing.buffer());
+        glBindVertexArray(0);
+        return;
+    }
+
     // 启用顶点属性 0: Position
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
     glEnableVertexAttribArray(0);
@@ -180,58 +577,668 @@ void initGrid() {
 }
 
 // --- 水面更新（有限差分）---
+// [0, 1) 的均匀随机数。不用 std::uniform_real_distribution：它的结果随标准库实现而不同。
+// 这只保证落点序列与标准库无关；叠加足迹用的 std::exp 在不同数学库下末位可能不同，高度场只在同一工具链下逐位可复现
+float rainUniform() {
+    return float(rainRng() >> 8) * (1.0f / 16777216.0f);
+}
+
+void seedRain(uint32_t seed) {
+    rainRng.seed(seed);
+    rainCarry = 0.0;
+}
+
+// 按 rainRate 产生这一步的雨滴，在当前模拟时间生效。返回雨滴数
+int emitRain() {
+    rainCarry += double(rainRate) * TIME_STEP;
+    const int drops = int(rainCarry);
+    rainCarry -= drops;
+    const double now = solverStep * double(TIME_STEP);
+    for (int i = 0; i < drops; ++i) {
+        Disturbance drop;
+        drop.x = 1.0f + rainUniform() * float(gridWidth - 3);
+        drop.y = 1.0f + rainUniform() * float(gridHeight - 3);
+        drop.radius = RAIN_RADIUS_MIN + rainUniform() * (RAIN_RADIUS_MAX - RAIN_RADIUS_MIN);
+        drop.amplitude = -RAIN_AMPLITUDE * (0.5f + 0.5f * rainUniform());
+        drop.time = now;
+        disturbanceQueue.push(drop); // 每步最多 100000 / 60 滴，远小于队列容量，而且本线程随后就取走
+    }
+    return drops;
+}
+
+// 扰动事件：两步之间到达的事件全部取出，到期的一次叠加，没到期的留到以后（保持入队顺序）
+void applyDisturbances() {
+    disturbanceQueue.drain(pendingEvents);
+    if (!pendingEvents.empty()) {
+        const double now = solverStep * double(TIME_STEP);
+        auto due = std::stable_partition(pendingEvents.begin(), pendingEvents.end(),
+                                         [now](const Disturbance& d) { return d.time <= now; });
+        waveSolver->splat(pendingEvents.data(), size_t(due - pendingEvents.begin()));
+        pendingEvents.erase(pendingEvents.begin(), due);
+    }
+}
+
+void synthesizeOcean() {
+    ++solverStep;
+    ocean->synthesize(float(solverStep * double(TIME_STEP)));
+    disturbanceQueue.drain(pendingEvents);
+    pendingEvents.clear();
+    const int n = ocean->size(), stride = waveSolver->stride();
+    const float* src = ocean->heights();
+    float* dst = waveSolver->mutableData();
+    for (int z = 0; z < n; ++z) {
+        for (int x = 0; x < n; ++x) {
+            dst[size_t(z) * stride + x] = src[size_t(z) * n + x] * (1.0f / HEIGHT_SCALE);
+        }
+    }
+}
+
 void updateWater() {
-    // 边界固定为0
-    for (int i = 1; i < GRID_HEIGHT - 1; ++i) {
-        for (int j = 1; j < GRID_WIDTH - 1; ++j) {
-			float laplacian = // 拉普拉斯算子
-                height[i - 1][j] + height[i + 1][j] +
-                height[i][j - 1] + height[i][j + 1] - 4 * height[i][j];
+    if (ocean) {
+        synthesizeOcean();
+        return;
+    }
+    // 边界固定为0；新高度写入独立缓冲区，整步只读上一时刻的值
+    waveSolver->step();
+    ++solverStep;
+    if (rainRate > 0.0f) {
+        emitRain();
+    }
+    applyDisturbances();
+}
+
+// 模拟线程：固定时间步累加器。每轮把流逝的真实时间累加起来，够一个 TIME_STEP 就推进一步，
+// 推进完把高度场发布出去；不够一步时睡到下一步到期
+void simulationLoop() {
+    stencilFlushDenormals(); // FTZ/DAZ 是线程局部的
+    auto last = std::chrono::steady_clock::now();
+    double accumulator = 0.0;
+    const size_t bytes = sizeof(float) * size_t(waveSolver->stride()) * gridHeight;
+    while (simRunning.load(std::memory_order_relaxed)) {
+        auto now = std::chrono::steady_clock::now();
+        accumulator += std::chrono::duration<double>(now - last).count();
+        last = now;
+
+        int steps = 0;
+        while (accumulator >= TIME_STEP && steps < MAX_STEPS_PER_TICK) {
+            updateWater();
+            accumulator -= TIME_STEP;
+            ++steps;
+        }
+        if (accumulator >= TIME_STEP) { // 这一轮补不完：丢掉积压，模拟放慢而不是越积越多
+            simDropped += uint64_t(accumulator / TIME_STEP);
+            accumulator = std::fmod(accumulator, double(TIME_STEP));
+        }
+        if (steps == 0) {
+            std::this_thread::sleep_for(std::chrono::duration<double>(TIME_STEP - accumulator));
+            continue;
+        }
 
-            float c2_dt2_dx2 = (WAVE_SPEED * WAVE_SPEED * TIME_STEP * TIME_STEP) / (GRID_SIZE * GRID_SIZE);
-            float newH = 2 * height[i][j] - prev_height[i][j] + c2_dt2_dx2 * laplacian;
-            newH *= DAMPING;
+        HeightSnapshot& snapshot = snapshots.writeBuffer();
+        std::memcpy(snapshot.heights.data(), waveSolver->data(), bytes);
+        simSteps += steps;
+        snapshots.publish();
+    }
+}
+
+void startSimulationThread() {
+    for (int k = 0; k < 3; ++k) {
+        snapshots.buffer(k).heights.allocate(size_t(waveSolver->stride()) * gridHeight);
+    }
+    frameHeights = snapshots.readBuffer().heights.data();
+    simRunning = true;
+    simThread = std::thread(simulationLoop);
+}
+
+void stopSimulationThread() {
+    if (simThread.joinable()) {
+        simRunning = false;
+        simThread.join();
+    }
+}
 
-            prev_height[i][j] = height[i][j];
-            height[i][j] = newH;
+// --- 无窗口基准测试 ---
+// 对高度场做 FNV-1a 哈希，用于比对不同运行/不同实现的结果是否逐位一致
+uint64_t heightChecksum() {
+    uint64_t hash = 1469598103934665603ull;
+    for (int z = 0; z < gridHeight; ++z) { // 逐行哈希，跳过行尾的对齐填充
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(waveSolver->data() + size_t(z) * waveSolver->stride());
+        for (size_t k = 0; k < sizeof(float) * gridWidth; ++k) {
+            hash ^= bytes[k];
+            hash *= 1099511628211ull;
         }
     }
+    return hash;
+}
+
+void copyHeightRows(void* dst, ThreadPool* pool);
+
+// 量化上传格式的转换速度和实测误差：把当前高度场打包若干次计时，再逐格解码与原值比较
+void reportHeightPacking(ThreadPool* pool) {
+    const int repeats = 20;
+    std::vector<uint16_t> staging(size_t(gridWidth) * gridHeight);
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeats; ++r) {
+        copyHeightRows(staging.data(), pool);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double packNs = std::chrono::duration<double, std::nano>(end - start).count() / repeats;
+
+    float maxError = 0.0f;
+    for (int z = 0; z < gridHeight; ++z) {
+        for (int x = 0; x < gridWidth; ++x) {
+            uint16_t stored = staging[size_t(z) * gridWidth + x];
+            float decoded = heightFormat == HeightFormat::F16
+                ? unpackHalf(stored)
+                : stored / 65535.0f * heightDecode.x + heightDecode.y;
+            maxError = std::max(maxError, std::fabs(decoded - waveSolver->at(x, z)));
+        }
+    }
+    std::cout << "[bench] upload " << heightFormatName(heightFormat) << ": "
+              << heightFormatBytes(heightFormat) << " bytes/cell (f32: 4), pack "
+              << packNs / (double(gridWidth) * gridHeight) << " ns/cell, max error " << maxError
+              << " (bound " << heightErrorBound << ")\n";
+}
+
+// CDLOD 节点选择：视锥体剔除 + 按距离选层级，结果写进 cdlodNodes。返回本帧要画的三角形数
+size_t selectCdlodNodes(const glm::mat4& viewProjection) {
+    float yRange = heightMaxAbs * HEIGHT_SCALE;
+    cdlodTree.select(cameraPos, CdlodFrustum::fromMatrix(viewProjection), -yRange, yRange, cdlodNodes);
+    return cdlodNodes.size() * size_t(2 * PATCH_RES * PATCH_RES);
+}
+
+// 从初始摄像机位置（800×800 窗口）做一次 CDLOD 节点选择，报告三角形数（对比整张网格）和选择耗时
+void reportCdlodSelection() {
+    heightMaxAbs = 0.0f;
+    for (int z = 0; z < gridHeight; ++z)
+        heightMaxAbs = std::max(heightMaxAbs, maxAbsHeight(waveSolver->data() + size_t(z) * waveSolver->stride(), gridWidth));
+    buildCdlodTree(800);
+    glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, viewDistance);
+
+    const int repeats = 100;
+    size_t triangles = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeats; ++r) {
+        triangles = selectCdlodNodes(projection * view);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double selectUs = std::chrono::duration<double, std::micro>(end - start).count() / repeats;
+    std::cout << "[cdlod] levels " << cdlodTree.levels() << ", LOD0 range " << cdlodTree.range(0)
+              << ", nodes " << cdlodNodes.size() << ", triangles " << triangles
+              << " (full grid " << 2ull * (gridWidth - 1) * (gridHeight - 1) << "), select " << selectUs << " us\n";
+}
+
+size_t dirtyRectBytes(const DirtyRect& rect);
+
+// 脏区上传的效果：静止水面中心扰动一次后逐帧推进（每帧一步），统计每帧需要上传的字节数和跟踪本身的耗时
+void reportDirtyUploads(ThreadPool* pool, int frames) {
+    waveSolver->reset();
+    waveSolver->disturb(gridWidth / 2, gridHeight / 2, 0.2f);
+    dirtyTiles.resize(gridWidth, gridHeight, DIRTY_TILE);
+    size_t fullBytes = size_t(gridWidth) * gridHeight * (renderMode == RenderMode::Vertex ? sizeof(Vertex) : size_t(heightFormatBytes(heightFormat)));
+    const int tailFrames = std::min(frames, 60);
+
+    double totalBytes = 0.0, tailBytes = 0.0, trackNs = 0.0;
+    for (int f = 0; f < frames; ++f) {
+        waveSolver->step();
+        auto start = std::chrono::steady_clock::now();
+        dirtyTiles.update(waveSolver->data(), waveSolver->stride(), dirtyThreshold, pool);
+        auto end = std::chrono::steady_clock::now();
+        trackNs += std::chrono::duration<double, std::nano>(end - start).count();
+        size_t bytes = 0;
+        for (const DirtyRect& rect : dirtyTiles.rects()) bytes += dirtyRectBytes(rect);
+        totalBytes += double(bytes);
+        if (f >= frames - tailFrames) tailBytes += double(bytes);
+    }
+    std::cout << "[dirty] " << frames << " frames, threshold " << dirtyThreshold << ": "
+              << totalBytes / frames / 1024.0 << " KB/frame (" << 100.0 * totalBytes / (double(fullBytes) * frames)
+              << "% of " << fullBytes / 1024.0 << " KB), last " << tailFrames << " frames "
+              << tailBytes / tailFrames / 1024.0 << " KB/frame, tracking "
+              << trackNs / (double(frames) * gridWidth * gridHeight) << " ns/cell\n";
+}
 
-    // 鼠标扰动
-    if (disturbX >= 0 && disturbY >= 0) {
-        int x = disturbX;
-        int y = disturbY;
-        if (x >= 1 && x < GRID_WIDTH - 1 && y >= 1 && y < GRID_HEIGHT - 1) {
-			height[y][x] += 0.2f; // 扰动幅度
+// 稀疏与稠密求解在 Neumann 边界、宽高 ≡ 1 (mod 32)（最后一行 / 列分块只剩边界格子的尺寸）下的最大差。
+// ε 取 FLT_MIN：FTZ 打开时没有更小的非零高度，任何非零的波前都会唤醒邻居，结果应逐位一致
+float sparseNeumannError(ThreadPool* pool) {
+    const int width = 257, height = 129, steps = 400;
+    WaveSolver sparse(width, height, C2_DT2_DX2, DAMPING, WaveBoundary::Neumann);
+    WaveSolver dense(width, height, C2_DT2_DX2, DAMPING, WaveBoundary::Neumann);
+    sparse.setThreadPool(pool);
+    dense.setThreadPool(pool);
+    sparse.setSparse(FLT_MIN);
+    float maxError = 0.0f;
+    for (WaveSolver* solver : { &sparse, &dense }) {
+        solver->disturb(width / 2, height / 2, 0.2f);
+        solver->disturb(width - 3, height - 3, 0.1f); // 紧挨着合并后的最后一行 / 列分块
+    }
+    for (int s = 0; s < steps; ++s) {
+        sparse.step();
+        dense.step();
+        for (int z = 0; z < height; ++z)
+            maxError = std::max(maxError, maxAbsDelta(sparse.data() + size_t(z) * sparse.stride(),
+                                                      dense.data() + size_t(z) * dense.stride(), width));
+    }
+    return maxError;
+}
+
+// 稀疏求解：报告平均活跃分块数，并用同样的扰动跑一遍稠密求解器，对比耗时和结果误差
+void reportSparseSolver(int steps, ThreadPool* pool, double sparseNs) {
+    WaveSolver::SparseStats stats = waveSolver->sparseStats();
+    WaveSolver dense(gridWidth, gridHeight, C2_DT2_DX2, DAMPING, WaveBoundary::Fixed);
+    dense.setThreadPool(pool);
+    auto start = std::chrono::steady_clock::now();
+    dense.step(); // 与 updateWater() 相同：先推进一步再叠加扰动
+    dense.disturb(gridWidth / 2, gridHeight / 2, 0.2f);
+    dense.advance(steps - 1);
+    auto end = std::chrono::steady_clock::now();
+    double denseNs = std::chrono::duration<double, std::nano>(end - start).count();
+
+    float maxError = 0.0f;
+    for (int z = 0; z < gridHeight; ++z)
+        maxError = std::max(maxError, maxAbsDelta(waveSolver->data() + size_t(z) * waveSolver->stride(),
+                                                  dense.data() + size_t(z) * dense.stride(), gridWidth));
+    std::cout << "[sparse] tiles " << stats.tiles << ", active " << stats.active << " now, "
+              << stats.averageActive << " on average (" << 100.0 * stats.averageActive / stats.tiles << "%); "
+              << sparseNs * 1e-6 << " ms vs dense " << denseNs * 1e-6 << " ms, max |sparse - dense| " << maxError << "\n";
+    std::cout << "[sparse] Neumann 257x129, epsilon FLT_MIN, 400 steps: max |sparse - dense| "
+              << sparseNeumannError(nullptr) << " (1 thread)";
+    if (pool && pool->size() > 1) {
+        std::cout << ", " << sparseNeumannError(pool) << " (" << pool->size() << " threads)";
+    }
+    std::cout << "\n";
+}
+
+// 拾取：从初始摄像机位置向网格内随机点发射 rays 条射线，对当前高度场求交。报告金字塔的重建 / 增量更新耗时、
+// 每条射线的耗时和访问节点数；前 64 条与逐格求交对比，并统计 Y=0 平面拾取与真实交点的水平偏差
+void reportPicking(int rays, ThreadPool* pool) {
+    const int stride = waveSolver->stride();
+    const float* heights = waveSolver->data();
+    heightPyramid.resize(gridWidth, gridHeight);
+    auto start = std::chrono::steady_clock::now();
+    heightPyramid.rebuild(heights, stride, pool);
+    auto mid = std::chrono::steady_clock::now();
+    const DirtyRect tile = { gridWidth / 2, gridHeight / 2, std::min(gridWidth / 2 + DIRTY_TILE, gridWidth),
+                             std::min(gridHeight / 2 + DIRTY_TILE, gridHeight) };
+    heightPyramid.update(heights, stride, std::vector<DirtyRect>(1, tile));
+    auto end = std::chrono::steady_clock::now();
+    double rebuildMs = std::chrono::duration<double, std::milli>(mid - start).count();
+    double tileUs = std::chrono::duration<double, std::micro>(end - mid).count();
+
+    // 射线在网格坐标下生成：起点为初始摄像机，终点在 Y=0 平面的网格内部
+    std::mt19937 rng(1);
+    auto uniform = [&rng]() { return float(rng() >> 8) * (1.0f / 16777216.0f); };
+    const glm::vec3 origin(cameraPos.x / GRID_SIZE + gridWidth / 2.0f, cameraPos.y / HEIGHT_SCALE,
+                           cameraPos.z / GRID_SIZE + gridHeight / 2.0f);
+    std::vector<glm::vec3> dirs(rays);
+    for (glm::vec3& dir : dirs) {
+        dir = glm::vec3(1.0f + uniform() * (gridWidth - 3), 0.0f, 1.0f + uniform() * (gridHeight - 3)) - origin;
+    }
+    int hits = 0;
+    uint64_t visitedSum = 0;
+    start = std::chrono::steady_clock::now();
+    for (const glm::vec3& dir : dirs) {
+        float t;
+        int visited;
+        hits += heightPyramid.raycast(origin, dir, FLT_MAX, heights, stride, t, &visited);
+        visitedSum += visited;
+    }
+    end = std::chrono::steady_clock::now();
+    double rayNs = std::chrono::duration<double, std::nano>(end - start).count() / std::max(rays, 1);
+
+    // 与逐格求交比较交点（世界坐标，米），并给出参考交点的高度范围，说明测的确实是起伏的水面
+    const glm::vec3 toWorld(GRID_SIZE, HEIGHT_SCALE, GRID_SIZE);
+    int checked = std::min(rays, 64), mismatches = 0, bothHit = 0;
+    double hitError = 0.0, maxHitError = 0.0;
+    float minHitY = FLT_MAX, maxHitY = -FLT_MAX;
+    for (int k = 0; k < checked; ++k) {
+        float t = 0.0f, reference = 0.0f;
+        bool hit = heightPyramid.raycast(origin, dirs[k], FLT_MAX, heights, stride, t);
+        bool referenceHit = heightPyramid.raycastAllCells(origin, dirs[k], FLT_MAX, heights, stride, reference);
+        if (hit != referenceHit || (hit && t != reference)) ++mismatches;
+        if (!hit || !referenceHit) continue;
+        const glm::vec3 point = (origin + dirs[k] * t) * toWorld, expected = (origin + dirs[k] * reference) * toWorld;
+        double error = glm::length(point - expected);
+        hitError += error;
+        maxHitError = std::max(maxHitError, error);
+        minHitY = std::min(minHitY, expected.y);
+        maxHitY = std::max(maxHitY, expected.y);
+        ++bothHit;
+    }
+    std::cout << "[pick] pyramid " << heightPyramid.levels() << " levels, rebuild " << rebuildMs << " ms, "
+              << DIRTY_TILE << "x" << DIRTY_TILE << " tile update " << tileUs << " us; " << rays << " rays: "
+              << rayNs << " ns/ray, " << double(visitedSum) / std::max(rays, 1) << " nodes/ray, " << hits << " hits\n";
+    std::cout << "[pick] " << mismatches << "/" << checked << " differ from brute force; hit point off by "
+              << hitError / std::max(bothHit, 1) << " m on average, " << maxHitError << " m at most; brute-force hits at heights ["
+              << (bothHit ? minHitY : 0.0f) << ", " << (bothHit ? maxHitY : 0.0f) << "] m\n";
+}
+
+// 雨压力测试：从每秒 1 滴起按 10 倍递增到 maxRate，每个速率都从静止水面、同一种子开始跑 steps 步，
+// 分别统计求解器（ns/cell）和雨滴生成 + 入队 + 批量叠加（ns/drop）的耗时，以及结果的校验和
+void reportRain(int steps, float maxRate) {
+    std::vector<float> rates;
+    for (float rate = 1.0f; rate < maxRate; rate *= 10.0f) rates.push_back(rate);
+    rates.push_back(maxRate);
+    const double cells = double(gridWidth - 2) * double(gridHeight - 2);
+    for (float rate : rates) {
+        waveSolver->reset();
+        solverStep = 0;
+        pendingEvents.clear();
+        seedRain(rainSeed);
+        rainRate = rate;
+        double solverNs = 0.0, splatNs = 0.0;
+        uint64_t drops = 0;
+        for (int s = 0; s < steps; ++s) {
+            auto start = std::chrono::steady_clock::now();
+            waveSolver->step();
+            ++solverStep;
+            auto mid = std::chrono::steady_clock::now();
+            drops += emitRain();
+            applyDisturbances();
+            auto end = std::chrono::steady_clock::now();
+            solverNs += std::chrono::duration<double, std::nano>(mid - start).count();
+            splatNs += std::chrono::duration<double, std::nano>(end - mid).count();
         }
-        disturbX = disturbY = -1; // 一次扰动
+        std::cout << "[rain] " << rate << " drops/s (" << double(drops) / steps << "/step): solver "
+                  << solverNs / (cells * steps) << " ns/cell, splat "
+                  << (drops > 0 ? splatNs / double(drops) : 0.0) << " ns/drop ("
+                  << (splatNs > 0.0 ? double(drops) / splatNs * 1e3 : 0.0) << " Mdrops/s), "
+                  << splatNs / (solverNs + splatNs) * 100.0 << "% of step time, checksum 0x"
+                  << std::hex << heightChecksum() << std::dec << "\n";
+    }
+    rainRate = 0.0f;
+}
+
+// 频谱海面：每步合成一次，分别统计频谱推进、批量逆 FFT 和写入高度场的耗时，再报告最后一帧的有效波高
+// （4 倍高度标准差）、最大水平位移和最大坡度
+void reportOcean(int steps) {
+    double spectrumMs = 0.0, fftMs = 0.0, copyMs = 0.0;
+    for (int s = 0; s < steps; ++s) {
+        auto start = std::chrono::steady_clock::now();
+        synthesizeOcean();
+        auto end = std::chrono::steady_clock::now();
+        spectrumMs += ocean->spectrumMs();
+        fftMs += ocean->fftMs();
+        copyMs += std::chrono::duration<double, std::milli>(end - start).count() - ocean->spectrumMs() - ocean->fftMs();
+    }
+    const int n = ocean->size();
+    const size_t count = size_t(n) * n;
+    double mean = 0.0, variance = 0.0;
+    float maxDisplacement = 0.0f, maxSlope = 0.0f;
+    for (size_t i = 0; i < count; ++i) mean += ocean->heights()[i];
+    mean /= double(count);
+    for (size_t i = 0; i < count; ++i) {
+        double d = ocean->heights()[i] - mean;
+        variance += d * d;
+        maxDisplacement = std::max(maxDisplacement, std::hypot(ocean->displacementX()[i], ocean->displacementZ()[i]));
+        maxSlope = std::max(maxSlope, std::hypot(ocean->gradientX()[i], ocean->gradientZ()[i]));
     }
+    variance /= double(count);
+    std::cout << "[ocean] " << oceanSpectrum << " " << n << "x" << n << ", " << steps << " steps: spectrum "
+              << spectrumMs / steps << " ms, batched c2r FFT (" << OceanFft::FIELD_COUNT << " fields) "
+              << fftMs / steps << " ms, copy " << copyMs / steps << " ms per step; Hs "
+              << 4.0 * std::sqrt(variance) << " m, max |D| " << maxDisplacement << " m, max slope " << maxSlope << "\n";
+}
+
+// 不创建窗口和 GL 上下文，固定步数运行 updateWater()，只统计求解器本身的耗时
+int runHeadlessBenchmark(int steps, ThreadPool* pool) {
+    if (ocean) {
+        reportOcean(steps);
+        return 0;
+    }
+    int threadCount = pool ? pool->size() : 1;
+    const float rain = rainRate; // 雨单独测（reportRain），主测试保持原来的单个中心扰动
+    rainRate = 0.0f;
+    waveSolver->reset();
+    solverStep = 0;
+    // 在中心放一个固定的单格扰动（半径 0），保证每次运行结果可复现
+    disturbanceQueue.push({ float(gridWidth / 2), float(gridHeight / 2), 0.0f, CLICK_AMPLITUDE, 0.0 });
+
+    auto start = std::chrono::steady_clock::now();
+    updateWater();                  // 第一步照常走 updateWater()，吃掉中心扰动
+    waveSolver->advance(steps - 1);  // 其余步一次性分派给线程池，步间用屏障同步
+    auto end = std::chrono::steady_clock::now();
+
+    double totalNs = std::chrono::duration<double, std::nano>(end - start).count();
+    double cells = double(gridWidth - 2) * double(gridHeight - 2); // 每步实际更新的内部格子数
+    double sum = 0.0;
+    for (int i = 0; i < gridHeight; ++i)
+        for (int j = 0; j < gridWidth; ++j)
+            sum += waveSolver->at(j, i);
+
+    std::cout << "[bench] grid " << gridWidth << "x" << gridHeight << ", steps " << steps
+              << ", isa " << stencilIsaName(stencilIsa()) << ", threads " << threadCount
+              << ", temporal " << waveSolver->temporalBlocking()
+              << ", specialized " << (stencilSpecialized() ? "on" : "off") << "\n";
+    std::cout << "[bench] total " << totalNs * 1e-6 << " ms, "
+              << (steps > 0 ? totalNs / (cells * steps) : 0.0) << " ns/cell/step\n";
+    std::cout << "[bench] checksum 0x" << std::hex << heightChecksum() << std::dec
+              << " (sum " << sum << ")\n";
+    if (waveSolver->sparse()) {
+        reportSparseSolver(steps, pool, totalNs);
+    }
+    frameHeights = waveSolver->data();
+    if (heightFormat != HeightFormat::F32) {
+        reportHeightPacking(pool);
+    }
+    if (renderMode == RenderMode::Cdlod) {
+        reportCdlodSelection();
+    }
+    else if (renderMode == RenderMode::Patch) {
+        reportPatchIndices();
+    }
+    else {
+        reportIndexOrder(buildGridIndices(gridWidth, gridHeight, indexOrder));
+    }
+    if (dirtyThreshold > 0.0f) {
+        reportDirtyUploads(pool, steps); // 会重置求解器，放在最后
+    }
+    if (rain > 0.0f) {
+        reportRain(steps, rain); // 同样会重置求解器
+    }
+    if (pickRays > 0) {
+        reportPicking(pickRays, pool); // 开了 --rain 时在最大雨量跑完的水面上测，起伏比单个中心扰动大得多
+    }
+    return 0;
 }
 
 // --- 更新 VBO 高度 ---
-void updateVertexBuffer() {
-    std::vector<Vertex> tempVertices(GRID_WIDTH * GRID_HEIGHT);
-    for (int z = 0; z < GRID_HEIGHT; ++z) {
-        for (int x = 0; x < GRID_WIDTH; ++x) {
-            float worldX = (x - GRID_WIDTH / 2.0f) * GRID_SIZE;
-            float worldZ = (z - GRID_HEIGHT / 2.0f) * GRID_SIZE;
-			float worldY = height[z][x] * 3.0f; // 放大高度以便观察
-            tempVertices[z * GRID_WIDTH + x].Position = glm::vec3(worldX, worldY, worldZ);
+// 写矩形 [x0, x1) × [z0, z1) 内的顶点，顶点 (x, z) 写到 dst[(z − z0) * dstStride + (x − x0)]。
+// dst 可以指向映射出来的显存（通常是写合并内存），只顺序写、不回读
+void writeVertexRect(Vertex* dst, size_t dstStride, int x0, int x1, int z0, int z1) {
+    const float* height = frameHeights; // height[z * stride + x]，行尾有对齐填充
+    const int stride = waveSolver->stride();
+    for (int z = z0; z < z1; ++z) {
+        for (int x = x0; x < x1; ++x) {
+            float worldX = (x - gridWidth / 2.0f) * GRID_SIZE;
+            float worldZ = (z - gridHeight / 2.0f) * GRID_SIZE;
+			float worldY = height[z * stride + x] * HEIGHT_SCALE; // 放大高度以便观察
 
             // 计算法线：用中心差分
             float dx = 0, dz = 0;
-            if (x > 0 && x < GRID_WIDTH - 1)
-                dx = (height[z][x - 1] - height[z][x + 1]) * 3.0f / (2 * GRID_SIZE);
-            if (z > 0 && z < GRID_HEIGHT - 1)
-                dz = (height[z - 1][x] - height[z + 1][x]) * 3.0f / (2 * GRID_SIZE);
+            if (x > 0 && x < gridWidth - 1)
+                dx = (height[z * stride + x - 1] - height[z * stride + x + 1]) * HEIGHT_SCALE / (2 * GRID_SIZE);
+            if (z > 0 && z < gridHeight - 1)
+                dz = (height[(z - 1) * stride + x] - height[(z + 1) * stride + x]) * HEIGHT_SCALE / (2 * GRID_SIZE);
 
             glm::vec3 normal = glm::normalize(glm::vec3(-dx, 1.0f, -dz));
-            tempVertices[z * GRID_WIDTH + x].Normal = normal;
+            dst[(z - z0) * dstStride + (x - x0)] = { glm::vec3(worldX, worldY, worldZ), normal };
+        }
+    }
+}
+
+// 写第 [z0, z1) 行的顶点
+void writeVertexRows(Vertex* dst, int z0, int z1) {
+    writeVertexRect(dst + size_t(z0) * gridWidth, gridWidth, 0, gridWidth, z0, z1);
+}
+
+// 求解器的输出直接写进环形缓冲区当前槽，没有中间数组和 glBufferSubData 拷贝；有线程池时按行条带并行写
+void updateVertexBuffer(ThreadPool* pool) {
+    Vertex* dst = static_cast<Vertex*>(vertexRing.beginWrite());
+    auto rows = [&](int t, int n) {
+        writeVertexRows(dst, gridHeight * t / n, gridHeight * (t + 1) / n);
+    };
+    if (pool && pool->size() > 1) {
+        pool->run(rows);
+    }
+    else {
+        rows(0, 1);
+    }
+    vertexSlotOffset = vertexRing.endWrite();
+}
+
+// 把高度按 heightFormat 逐行紧密写进 dst（去掉行尾填充），放大倍数交给着色器；有线程池时按行条带并行。
+// 同时更新 heightDecode、heightErrorBound 和 heightMaxAbs
+void copyHeightRows(void* dst, ThreadPool* pool) {
+    const float* height = frameHeights;
+    const int stride = waveSolver->stride();
+    const int threads = pool ? pool->size() : 1;
+    auto run = [&](const std::function<void(int, int)>& task) {
+        if (threads > 1) pool->run(task);
+        else task(0, 1);
+    };
+
+    // q16：先求整张网格的最大绝对值，量化范围取 [-max, max]，每帧都用满 16 位
+    float lo = 0.0f, hi = 1.0f;
+    if (heightFormat == HeightFormat::Q16) {
+        std::vector<float> partial(threads, 0.0f);
+        run([&](int t, int n) {
+            for (int z = gridHeight * t / n; z < gridHeight * (t + 1) / n; ++z) {
+                partial[t] = std::max(partial[t], maxAbsHeight(height + size_t(z) * stride, gridWidth));
+            }
+        });
+        float range = std::max(*std::max_element(partial.begin(), partial.end()), 1e-6f);
+        lo = -range;
+        hi = range;
+    }
+
+    std::vector<float> partialMax(threads, 0.0f);
+    run([&](int t, int n) {
+        for (int z = gridHeight * t / n; z < gridHeight * (t + 1) / n; ++z) {
+            const float* src = height + size_t(z) * stride;
+            size_t offset = size_t(z) * gridWidth;
+            switch (heightFormat) {
+            case HeightFormat::F16:
+                packHeightsHalf(static_cast<uint16_t*>(dst) + offset, src, gridWidth);
+                partialMax[t] = std::max(partialMax[t], maxAbsHeight(src, gridWidth));
+                break;
+            case HeightFormat::Q16:
+                packHeightsUnorm16(static_cast<uint16_t*>(dst) + offset, src, gridWidth, lo, hi);
+                break;
+            default:
+                std::copy(src, src + gridWidth, static_cast<float*>(dst) + offset);
+                partialMax[t] = std::max(partialMax[t], maxAbsHeight(src, gridWidth)); // 这一行刚读过，还在缓存里
+                break;
+            }
+        }
+    });
+    heightMaxAbs = heightFormat == HeightFormat::Q16 ? hi : *std::max_element(partialMax.begin(), partialMax.end());
+
+    switch (heightFormat) {
+    case HeightFormat::F16:
+        heightDecode = glm::vec2(1.0f, 0.0f);
+        heightErrorBound = halfErrorBound(heightMaxAbs);
+        break;
+    case HeightFormat::Q16:
+        heightDecode = glm::vec2(hi - lo, lo); // GL 把 0…65535 归一化为 0…1
+        heightErrorBound = unorm16ErrorBound(lo, hi);
+        break;
+    default:
+        heightDecode = glm::vec2(1.0f, 0.0f);
+        heightErrorBound = 0.0f;
+        break;
+    }
+}
+
+// RenderMode::Texture：高度拷进像素解包缓冲区的当前槽，再由 GPU 从缓冲区更新纹理（异步，不等待）
+void updateHeightTexture(ThreadPool* pool) {
+    copyHeightRows(vertexRing.beginWrite(), pool);
+    size_t offset = vertexRing.endWrite();
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, vertexRing.buffer());
+    glBindTexture(GL_TEXTURE_2D, heightTexture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, gridWidth, gridHeight, GL_RED, heightGLFormat().type, (void*)offset);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+// vertex 模式下脏区向外扩一圈：相邻格子的法线用到了脏区边上的高度
+DirtyRect vertexUploadRect(const DirtyRect& rect) {
+    return { std::max(rect.x0 - 1, 0), std::max(rect.z0 - 1, 0),
+             std::min(rect.x1 + 1, gridWidth), std::min(rect.z1 + 1, gridHeight) };
+}
+
+// 一个脏区矩形要上传的字节数
+size_t dirtyRectBytes(const DirtyRect& rect) {
+    if (renderMode == RenderMode::Vertex) {
+        DirtyRect r = vertexUploadRect(rect);
+        return size_t(r.x1 - r.x0) * (r.z1 - r.z0) * sizeof(Vertex);
+    }
+    return size_t(rect.x1 - rect.x0) * (rect.z1 - rect.z0) * heightFormatBytes(heightFormat);
+}
+
+// 脏区上传：比较快照找出脏块，只重写、只上传脏区。vertex 模式写进普通顶点缓冲（整行的脏区是一段连续内存，一次
+// glBufferSubData；否则逐行），纹理模式按子矩形 glTexSubImage2D。未上传部分的误差不超过 dirtyThreshold
+void updateDirtyTiles(ThreadPool* pool) {
+    dirtyTiles.update(frameHeights, waveSolver->stride(), dirtyThreshold, pool);
+    heightMaxAbs = dirtyTiles.maxAbsHeight(); // 画出来的是快照
+    heightDecode = glm::vec2(1.0f, 0.0f);
+    heightErrorBound = dirtyThreshold + (heightFormat == HeightFormat::F16 ? halfErrorBound(heightMaxAbs) : 0.0f);
+    uploadBytes = 0;
+
+    if (renderMode == RenderMode::Vertex) {
+        std::vector<Vertex> staging;
+        glBindBuffer(GL_ARRAY_BUFFER, vertexVBO);
+        for (const DirtyRect& rect : dirtyTiles.rects()) {
+            DirtyRect r = vertexUploadRect(rect);
+            size_t rowVertices = size_t(r.x1 - r.x0);
+            staging.resize(rowVertices * (r.z1 - r.z0));
+            writeVertexRect(staging.data(), rowVertices, r.x0, r.x1, r.z0, r.z1);
+            if (rowVertices == size_t(gridWidth)) {
+                glBufferSubData(GL_ARRAY_BUFFER, size_t(r.z0) * gridWidth * sizeof(Vertex), staging.size() * sizeof(Vertex), staging.data());
+            }
+            else {
+                for (int z = r.z0; z < r.z1; ++z) {
+                    glBufferSubData(GL_ARRAY_BUFFER, (size_t(z) * gridWidth + r.x0) * sizeof(Vertex), rowVertices * sizeof(Vertex),
+                                    staging.data() + (z - r.z0) * rowVertices);
+                }
+            }
+            uploadBytes += staging.size() * sizeof(Vertex);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        // 外扩的一圈属于干净分块，它们的快照也要跟上已上传的高度
+        for (const DirtyRect& rect : dirtyTiles.rects()) {
+            dirtyTiles.refresh(frameHeights, waveSolver->stride(), vertexUploadRect(rect));
+        }
+        heightMaxAbs = dirtyTiles.maxAbsHeight();
+        return;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, heightTexture);
+    std::vector<uint16_t> staging;
+    for (const DirtyRect& r : dirtyTiles.rects()) {
+        int w = r.x1 - r.x0, h = r.z1 - r.z0;
+        if (heightFormat == HeightFormat::F16) {
+            staging.resize(size_t(w) * h);
+            for (int z = r.z0; z < r.z1; ++z) {
+                packHeightsHalf(staging.data() + size_t(z - r.z0) * w, frameHeights + size_t(z) * waveSolver->stride() + r.x0, w);
+            }
+            glTexSubImage2D(GL_TEXTURE_2D, 0, r.x0, r.z0, w, h, GL_RED, GL_HALF_FLOAT, staging.data());
         }
+        else {
+            // f32 直接从高度场（求解器缓冲区或快照）上传，行跨度交给 GL_UNPACK_ROW_LENGTH
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, waveSolver->stride());
+            glTexSubImage2D(GL_TEXTURE_2D, 0, r.x0, r.z0, w, h, GL_RED, GL_FLOAT,
+                            frameHeights + size_t(r.z0) * waveSolver->stride() + r.x0);
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        }
+        uploadBytes += dirtyRectBytes(r);
     }
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, tempVertices.size() * sizeof(Vertex), tempVertices.data());
+// RenderMode::Height：只把高度拷进顶点环形缓冲区的当前槽
+void updateHeightStream(ThreadPool* pool) {
+    copyHeightRows(vertexRing.beginWrite(), pool);
+    vertexSlotOffset = vertexRing.endWrite();
 }
 
 // --- 摄像机控制 ---
@@ -286,8 +1293,24 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
     if (movementSpeed > 20.0f) movementSpeed = 20.0f;
 }
 
-// 将鼠标屏幕坐标转换为世界坐标
-glm::vec3 getMouseWorldPos(GLFWwindow* window, double mouseX, double mouseY) {
+// 世界坐标下的射线与水面的最近交点。网格坐标：x / z 以格子为单位，y 为模拟高度（渲染时乘 HEIGHT_SCALE）
+bool pickSurface(const glm::vec3& origin, const glm::vec3& dir, glm::vec3& hit) {
+    if (pyramidStale) {
+        heightPyramid.rebuild(frameHeights, waveSolver->stride(), nullptr);
+        pyramidStale = false;
+    }
+    const glm::vec3 scale(1.0f / GRID_SIZE, 1.0f / HEIGHT_SCALE, 1.0f / GRID_SIZE);
+    const glm::vec3 offset(gridWidth / 2.0f, 0.0f, gridHeight / 2.0f);
+    float t;
+    if (!heightPyramid.raycast(origin * scale + offset, dir * scale, FLT_MAX, frameHeights, waveSolver->stride(), t)) {
+        return false;
+    }
+    hit = origin + t * dir; // 两个坐标系只差缩放和平移，参数 t 相同
+    return true;
+}
+
+// 将鼠标屏幕坐标转换为水面上的世界坐标，射线没有碰到水面时返回 false
+bool getMouseWorldPos(GLFWwindow* window, double mouseX, double mouseY, glm::vec3& hit) {
     int width, height;
     glfwGetFramebufferSize(window, &width, &height);
 
@@ -297,7 +1320,7 @@ glm::vec3 getMouseWorldPos(GLFWwindow* window, double mouseX, double mouseY) {
 
     // 投影和视图矩阵
     glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-    glm::mat4 proj = glm::perspective(glm::radians(45.0f), (float)width / height, 0.1f, 100.0f);
+    glm::mat4 proj = glm::perspective(glm::radians(45.0f), (float)width / height, 0.1f, viewDistance);
     glm::mat4 invVP = glm::inverse(proj * view);
 
     // 近平面和远平面上的点
@@ -310,12 +1333,8 @@ glm::vec3 getMouseWorldPos(GLFWwindow* window, double mouseX, double mouseY) {
     glm::vec3 rayOrigin = cameraPos;
     glm::vec3 rayDir = glm::normalize(glm::vec3(farPoint) - glm::vec3(nearPoint));
 
-    // 射线与 Y=0 平面求交
-    float t = (0.0f - rayOrigin.y) / rayDir.y;
-    if (t < 0) return glm::vec3(0); // 射线向下才有效
-
-    glm::vec3 hitPoint = rayOrigin + t * rayDir;
-    return hitPoint;
+    // 射线与起伏的水面求交（不再是 Y=0 平面，浪大时点哪儿就是哪儿）
+    return pickSurface(rayOrigin, rayDir, hit);
 }
 
 // 鼠标点击扰动水面
@@ -331,22 +1350,180 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
     if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
         double xpos, ypos;
         glfwGetCursorPos(window, &xpos, &ypos);
-        glm::vec3 worldPos = getMouseWorldPos(window, xpos, ypos);
+        glm::vec3 worldPos;
+        if (!getMouseWorldPos(window, xpos, ypos, worldPos)) {
+            return;
+        }
 
-        // 转换为网格索引
-        int gridX = (int)std::round(worldPos.x / GRID_SIZE + GRID_WIDTH / 2.0f);
-        int gridY = (int)std::round(worldPos.z / GRID_SIZE + GRID_HEIGHT / 2.0f); // 注意：Z 对应网格的 Y
+        // 转换为网格坐标（高斯足迹的中心不必落在格点上）
+        float gridX = worldPos.x / GRID_SIZE + gridWidth / 2.0f;
+        float gridY = worldPos.z / GRID_SIZE + gridHeight / 2.0f; // 注意：Z 对应网格的 Y
 
-        // 边界检查
-        if (gridX >= 1 && gridX < GRID_WIDTH - 1 && gridY >= 1 && gridY < GRID_HEIGHT - 1) {
-            disturbX = gridX;
-            disturbY = gridY;
+        // 边界检查；time 为 0 表示下一步立即生效。求解线程每步取走全部事件，两步之间的多次点击都不会丢
+        if (gridX >= 1 && gridX < gridWidth - 1 && gridY >= 1 && gridY < gridHeight - 1) {
+            disturbanceQueue.push({ gridX, gridY, CLICK_RADIUS, CLICK_AMPLITUDE, 0.0 });
         }
     }
 }
 
 // --- Main ---
-int main() {
+// 用法：height_field [--size WxH] [--bench 步数] [--isa scalar|sse4.2|avx2|avx512] [--threads 线程数]
+//                    [--temporal 子步数] [--specialize 0|1] [--persistent 0|1] [--render vertex|height|texture|cdlod|patch]
+//                    [--height_format f32|f16|q16] [--index_order rows|stripes]
+//                    [--dirty_threshold 阈值] [--sparse 阈值] [--sim_thread 0|1]
+//                    [--rain 每秒滴数] [--rain_seed 种子] [--picks 射线数]
+//                    [--ocean phillips|jonswap] [--wind 风速] [--fftw_plan estimate|measure|patient]
+//                    [--config 配置文件]
+// --size / --width / --height：网格分辨率（默认 128×128），不用重新编译就能做分辨率扫描
+// --bench：无窗口模式，只跑求解器并输出耗时与校验和（适合没有 GPU 的 CI 机器）
+// --isa：强制使用指定的模板内核（默认按 CPUID 自动选择），scalar 用于逐位比对
+// --threads：求解器线程数，按行条带划分网格，0 表示使用全部硬件线程（默认 1）
+// --temporal：时间分块，每个缓存大小的分块连续推进 K 步（只影响一次推进多步的 --bench）
+// --specialize：0 表示关闭常用分辨率（128…4096 的正方形网格）的编译期特化内核，用于对比
+// --persistent：0 表示顶点上传不用持久映射环形缓冲区，强制走 GL 3.3 的孤立方式，用于对比
+// --render：vertex 每帧上传完整顶点（默认）；height 每帧只上传高度，位置和法线在顶点着色器里重建；
+//           texture 每帧把高度场作为纹理上传，静态网格在顶点着色器里位移并计算法线；
+//           cdlod 同样上传高度纹理，按四叉树分块选 LOD 并剔除视锥体外的块，三角形数随屏幕分辨率而不是网格大小增长
+//           （--bench 时报告初始视角下选出的节点数和三角形数）；patch 同样上传高度纹理，整个水面用一块 32×32 的补丁网格
+//           实例化绘制，不再生成整网格的索引缓冲（--bench 时对比两者的索引内存和生成时间）
+// --index_order：三角形索引顺序，stripes 按竖条生成（默认，顶点缓存命中率高），rows 为原来的逐行顺序；
+//                --bench 时也会输出两种顺序的 ACMR
+// --height_format：height / texture 模式的上传格式：f32（默认）、f16 半精度、q16 16 位定点（每帧按最大振幅量化）
+// --dirty_threshold：> 0 时按 32×32 分块跟踪高度变化，只重新上传变化超过该值的分块（vertex / texture / cdlod / patch 模式，
+//                   f32 或 f16）；--bench 时额外模拟一次中心扰动，输出每帧上传量
+// --sparse：> 0 时求解器只推进活跃的 32×32 分块，当前和上一步高度都低于该值的分块休眠，波前到达或点击时唤醒；
+//           --bench 时报告平均活跃分块数，并与稠密求解对比耗时和误差
+// --sim_thread：1（默认）求解器在独立线程上按固定时间步推进，经三重缓冲把高度场交给渲染，模拟速度与帧率无关；
+//              0 表示与渲染串行，每帧一步
+// --rain：每秒随机落下这么多雨滴（0 ~ 100000，默认 0）；--bench 时从每秒 1 滴按 10 倍递增到该值，报告求解和叠加的吞吐量
+// --rain_seed：雨滴随机数种子（默认 1），同一种子的结果可复现
+// --picks：--bench 时从初始摄像机发射这么多条拾取射线，报告高度金字塔的更新耗时、每条射线的耗时，并与逐格求交校验
+// --ocean：phillips 或 jonswap，改用 FFT 频谱海面（Tessendorf）代替有限差分求解器，网格须为偶数边长的正方形
+// --wind：频谱海面的风速（米/秒，默认 10）
+// --fftw_plan：estimate、measure（默认）或 patient，FFT 计划的严格程度。实测结果按尺寸、CPU 型号和线程数缓存在
+//              当前目录的 fftw_wisdom_*.txt 里，之后启动直接读入；FFT 的线程数跟随 --threads
+// --config：从文件读取以上参数（每行 key = value），见 sim_config.h
+int main(int argc, char** argv) {
+    stencilFlushDenormals(); // 衰减后的微小波高按 0 处理，避免非规格化数拖慢求解器
+
+    SimConfig config;
+    if (!parseSimConfig(argc, argv, config)) {
+        return -1;
+    }
+    if (!config.isa.empty()) {
+        StencilIsa isa;
+        if (!parseStencilIsa(config.isa.c_str(), isa)) {
+            std::cerr << "Unknown --isa " << config.isa << "\n";
+            return -1;
+        }
+        setStencilIsa(isa);
+    }
+    setStencilSpecialized(config.specialize != 0);
+    if (config.render == "height") {
+        renderMode = RenderMode::Height;
+    }
+    else if (config.render == "texture") {
+        renderMode = RenderMode::Texture;
+    }
+    else if (config.render == "cdlod") {
+        renderMode = RenderMode::Cdlod;
+    }
+    else if (config.render == "patch") {
+        renderMode = RenderMode::Patch;
+    }
+    else if (!config.render.empty() && config.render != "vertex") {
+        std::cerr << "Unknown --render " << config.render << "\n";
+        return -1;
+    }
+    if (config.indexOrder == "rows") {
+        indexOrder = GridIndexOrder::Rows;
+    }
+    else if (!config.indexOrder.empty() && config.indexOrder != "stripes") {
+        std::cerr << "Unknown --index_order " << config.indexOrder << "\n";
+        return -1;
+    }
+    if (!config.heightFormat.empty() && !parseHeightFormat(config.heightFormat.c_str(), heightFormat)) {
+        std::cerr << "Unknown --height_format " << config.heightFormat << "\n";
+        return -1;
+    }
+    dirtyThreshold = config.dirtyThreshold;
+    if (dirtyThreshold < 0.0f || (dirtyThreshold > 0.0f && (renderMode == RenderMode::Height || heightFormat == HeightFormat::Q16))) {
+        std::cerr << "--dirty_threshold must be >= 0 and needs --render vertex, texture, cdlod or patch with f32 or f16 heights\n";
+        return -1;
+    }
+    if (heightFormat != HeightFormat::F32 && renderMode == RenderMode::Vertex && config.benchSteps == 0) {
+        std::cerr << "--height_format " << config.heightFormat << " needs --render height, texture, cdlod or patch\n";
+        return -1;
+    }
+
+    gridWidth = config.width;
+    gridHeight = config.height;
+    waveSolver.reset(new WaveSolver(gridWidth, gridHeight, C2_DT2_DX2, DAMPING, WaveBoundary::Fixed));
+    waveSolver->setTemporalBlocking(config.temporal);
+    if (config.sparse < 0.0f) {
+        std::cerr << "--sparse must be >= 0\n";
+        return -1;
+    }
+    waveSolver->setSparse(config.sparse);
+    if (config.simThread != 0 && config.simThread != 1) {
+        std::cerr << "--sim_thread must be 0 or 1\n";
+        return -1;
+    }
+    if (config.rain < 0.0f || config.rain > 100000.0f) {
+        std::cerr << "--rain must be between 0 and 100000 drops per second\n";
+        return -1;
+    }
+    if (config.picks < 0) {
+        std::cerr << "--picks must be >= 0\n";
+        return -1;
+    }
+    pickRays = config.picks;
+    rainRate = config.rain;
+    rainSeed = uint32_t(config.rainSeed);
+    seedRain(rainSeed);
+    if (renderMode == RenderMode::Cdlod) {
+        viewDistance = std::max(viewDistance, std::hypot(float(gridWidth), float(gridHeight)) * GRID_SIZE);
+    }
+
+    std::unique_ptr<ThreadPool> solverPool;
+    if (config.threads != 1) {
+        solverPool.reset(new ThreadPool(config.threads));
+        waveSolver->setThreadPool(solverPool.get());
+    }
+
+    if (!config.ocean.empty()) {
+        OceanParams params;
+        if (config.ocean == "phillips") params.spectrum = OceanSpectrum::Phillips;
+        else if (config.ocean == "jonswap") params.spectrum = OceanSpectrum::Jonswap;
+        else {
+            std::cerr << "Unknown --ocean " << config.ocean << "\n";
+            return -1;
+        }
+        if (gridWidth != gridHeight || gridWidth % 2 != 0 || config.wind <= 0.0f) {
+            std::cerr << "--ocean needs a square grid with an even size and --wind > 0\n";
+            return -1;
+        }
+        if (!config.fftwPlan.empty() && !parseFftwRigor(config.fftwPlan, params.planRigor)) {
+            std::cerr << "Unknown --fftw_plan " << config.fftwPlan << "\n";
+            return -1;
+        }
+        params.size = gridWidth;
+        params.patchLength = gridWidth * GRID_SIZE;
+        params.windSpeed = config.wind;
+        fftwSetThreads(config.threads); // 与求解器相同的线程数设置
+        ocean.reset(new OceanFft(params));
+        ocean->setThreadPool(solverPool.get());
+        oceanSpectrum = config.ocean;
+        const FftwPlanInfo& plan = ocean->planInfo();
+        std::cout << "[fftw] " << fftwThreads() << " threads, plan " << plan.planMs << " ms"
+                  << (plan.path.empty() ? std::string(" (estimate, no cache)")
+                      : (plan.fromCache ? " from wisdom cache " : " measured, saved to ") + plan.path) << "\n";
+    }
+
+    if (config.benchSteps > 0) {
+        return runHeadlessBenchmark(config.benchSteps, solverPool.get());
+    }
+
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -373,10 +1550,38 @@ int main() {
     glEnable(GL_DEPTH_TEST);
     glViewport(0, 0, 800, 800);
 
-    shaderProgram = createShaderProgram();
-    initGrid();
+    if (renderMode == RenderMode::Height) {
+        GLint maxTexels = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+        if (double(gridWidth) * gridHeight * StreamBuffer::SLOTS > double(maxTexels)) {
+            std::cerr << "Grid too large for a buffer texture (max " << maxTexels << " texels), using --render vertex\n";
+            renderMode = RenderMode::Vertex;
+        }
+    }
+    const char* vertexSource = renderMode == RenderMode::Height ? heightVertexShaderSource
+                             : renderMode == RenderMode::Texture ? textureVertexShaderSource
+                             : renderMode == RenderMode::Cdlod || renderMode == RenderMode::Patch ? patchVertexShaderSource
+                             : vertexShaderSource;
+    shaderProgram = createShaderProgram(vertexSource);
+    buildCdlodTree(800);
+    initGrid(config.persistent != 0);
+    dirtyTiles.resize(gridWidth, gridHeight, DIRTY_TILE);
+    heightPyramid.resize(gridWidth, gridHeight, dirtyThreshold);
 
     float lastFrame = 0.0f;
+    float lastTitleUpdate = 0.0f;
+    int framesSinceTitle = 0;
+    uint64_t stepsAtTitle = 0;
+
+    // 开启模拟线程后线程池归模拟线程使用，渲染端的上传改为单线程
+    const bool threadedSim = config.simThread != 0;
+    ThreadPool* uploadPool = threadedSim ? nullptr : solverPool.get();
+    if (threadedSim) {
+        startSimulationThread();
+    }
+    else {
+        frameHeights = waveSolver->data();
+    }
 
     while (!glfwWindowShouldClose(window)) {
         float currentFrame = glfwGetTime();
@@ -384,8 +1589,38 @@ int main() {
         lastFrame = currentFrame;
 
         processInput(window, deltaTime);
-        updateWater();
-        updateVertexBuffer();
+        bool newHeights = true;
+        if (threadedSim) {
+            newHeights = snapshots.acquire(); // 没有新快照时不重新上传，直接重画上一帧的数据
+            frameHeights = snapshots.readBuffer().heights.data();
+        }
+        else {
+            updateWater(); // 串行：每帧推进一步（假定帧时间等于 TIME_STEP）
+            frameHeights = waveSolver->data();
+        }
+        if (!newHeights) {
+            // 模拟线程还没发布新的一步：GPU 上已经是最新数据，不用上传
+        }
+        else if (dirtyThreshold > 0.0f) {
+            updateDirtyTiles(uploadPool);
+        }
+        else if (renderMode == RenderMode::Height) {
+            updateHeightStream(uploadPool);
+        }
+        else if (renderMode == RenderMode::Texture || renderMode == RenderMode::Cdlod || renderMode == RenderMode::Patch) {
+            updateHeightTexture(uploadPool); // 不再有 CPU 法线计算
+        }
+        else {
+            updateVertexBuffer(uploadPool);
+        }
+        if (newHeights) {
+            if (dirtyThreshold > 0.0f) {
+                heightPyramid.update(frameHeights, waveSolver->stride(), dirtyTiles.rects());
+            }
+            else {
+                pyramidStale = true;
+            }
+        }
 
         glClearColor(0.1f, 0.2f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -393,7 +1628,7 @@ int main() {
         glUseProgram(shaderProgram);
 
         glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 800.0f, 0.1f, 100.0f);
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 800.0f, 0.1f, viewDistance);
         glm::mat4 model = glm::mat4(1.0f);
 
         unsigned int modelLoc = glGetUniformLocation(shaderProgram, "model");
@@ -406,16 +1641,100 @@ int main() {
         glUniform3fv(glGetUniformLocation(shaderProgram, "lightPos"), 1, glm::value_ptr(glm::vec3(10.0f, 20.0f, 10.0f)));
         glUniform3fv(glGetUniformLocation(shaderProgram, "viewPos"), 1, glm::value_ptr(cameraPos));
 
+        GLint baseVertex = 0; // 顶点环形缓冲区中本帧的槽；texture 模式下网格是静态的，始终为 0
+        if (renderMode == RenderMode::Vertex || renderMode == RenderMode::Height)
+            baseVertex = GLint(vertexSlotOffset / (renderMode == RenderMode::Height ? heightFormatBytes(heightFormat) : sizeof(Vertex)));
+        if (renderMode == RenderMode::Height) {
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_BUFFER, heightTBO);
+            glUniform1i(glGetUniformLocation(shaderProgram, "heightBuffer"), 0);
+            glUniform2i(glGetUniformLocation(shaderProgram, "gridSize"), gridWidth, gridHeight);
+            glUniform1i(glGetUniformLocation(shaderProgram, "slotBase"), baseVertex);
+            glUniform1f(glGetUniformLocation(shaderProgram, "gridSpacing"), GRID_SIZE);
+            glUniform1f(glGetUniformLocation(shaderProgram, "heightScale"), HEIGHT_SCALE);
+            glUniform2fv(glGetUniformLocation(shaderProgram, "heightDecode"), 1, glm::value_ptr(heightDecode));
+        }
+        else {
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, heightTexture);
+            glUniform1i(glGetUniformLocation(shaderProgram, "heightMap"), 0);
+            glUniform2i(glGetUniformLocation(shaderProgram, "gridSize"), gridWidth, gridHeight);
+            glUniform1f(glGetUniformLocation(shaderProgram, "gridSpacing"), GRID_SIZE);
+            glUniform1f(glGetUniformLocation(shaderProgram, "heightScale"), HEIGHT_SCALE);
+            glUniform2fv(glGetUniformLocation(shaderProgram, "heightDecode"), 1, glm::value_ptr(heightDecode));
+        }
+
+        size_t triangles = size_t(indexCount / 3);
         glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, (GRID_WIDTH - 1) * (GRID_HEIGHT - 1) * 6, GL_UNSIGNED_INT, 0);
+        if (renderMode == RenderMode::Cdlod || renderMode == RenderMode::Patch) {
+            // 一次实例化绘制画完所有补丁：每个实例的起点和缩放来自顶点属性 1，形变区间按层级查表
+            glm::vec2 morphRanges[CdlodQuadtree::MAX_LEVELS];
+            for (int level = 0; level < CdlodQuadtree::MAX_LEVELS; ++level) {
+                morphRanges[level] = renderMode == RenderMode::Cdlod ? cdlodTree.morphRange(level) : glm::vec2(1e30f, 2e30f);
+            }
+            if (renderMode == RenderMode::Cdlod) {
+                triangles = selectCdlodNodes(projection * view);
+                std::vector<glm::vec4> instances;
+                instances.reserve(cdlodNodes.size());
+                for (const CdlodNode& node : cdlodNodes) {
+                    instances.push_back(glm::vec4(float(node.x), float(node.z), float(node.size / PATCH_RES), float(node.level)));
+                }
+                instanceCount = GLsizei(instances.size());
+                glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+                glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(glm::vec4), instances.data(), GL_STREAM_DRAW); // 只有几 KB，孤立即可
+            }
+            else {
+                triangles = size_t(instanceCount) * (indexCount / 3);
+            }
+            glUniform3fv(glGetUniformLocation(shaderProgram, "cameraPos"), 1, glm::value_ptr(cameraPos));
+            glUniform2fv(glGetUniformLocation(shaderProgram, "morphRanges"), CdlodQuadtree::MAX_LEVELS, glm::value_ptr(morphRanges[0]));
+            glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0, instanceCount);
+        }
+        else {
+            glDrawElementsBaseVertex(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0, baseVertex);
+        }
         glBindVertexArray(0);
+        vertexRing.endFrame(); // 这一帧的绘制已提交，给正在绘制的槽插入栅栏
+        ++framesSinceTitle;
+
+        // 每秒在标题栏报告一次：模拟线程的步数 / 秒和渲染帧率；量化 / 脏区上传时为当前帧的误差上界（模拟高度单位），
+        // cdlod 模式下为选出的节点数和三角形数，脏区上传时为本帧的脏块数和上传字节数
+        bool showStats = heightFormat != HeightFormat::F32 || renderMode == RenderMode::Cdlod || dirtyThreshold > 0.0f || threadedSim;
+        if (showStats && currentFrame - lastTitleUpdate >= 1.0f) {
+            float elapsed = currentFrame - lastTitleUpdate;
+            lastTitleUpdate = currentFrame;
+            std::ostringstream title;
+            title << "Height Field Water Simulation";
+            if (threadedSim) {
+                uint64_t steps = simSteps.load();
+                title << " - sim " << int((steps - stepsAtTitle) / elapsed) << " steps/s, render " << int(framesSinceTitle / elapsed) << " fps";
+                if (simDropped.load() > 0)
+                    title << ", " << simDropped.load() << " steps dropped";
+                stepsAtTitle = steps;
+            }
+            framesSinceTitle = 0;
+            if (heightFormat != HeightFormat::F32 || dirtyThreshold > 0.0f)
+                title << " - " << heightFormatName(heightFormat) << " upload, max error " << heightErrorBound;
+            if (dirtyThreshold > 0.0f)
+                title << " - dirty " << dirtyTiles.dirtyCount() << "/" << dirtyTiles.tileCount() << " tiles, "
+                      << uploadBytes / 1024 << " KB uploaded";
+            if (renderMode == RenderMode::Cdlod)
+                title << " - cdlod " << cdlodNodes.size() << " nodes, " << triangles << " triangles";
+            glfwSetWindowTitle(window, title.str().c_str());
+        }
 
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
+    stopSimulationThread();
     glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
+    vertexRing.destroy(); // 必须在上下文销毁之前释放
+    glDeleteTextures(1, &heightTBO);
+    glDeleteTextures(1, &heightTexture);
+    glDeleteBuffers(1, &meshVBO);
+    glDeleteBuffers(1, &instanceVBO);
+    glDeleteBuffers(1, &vertexVBO);
     glDeleteBuffers(1, &EBO);
     glDeleteProgram(shaderProgram);
 
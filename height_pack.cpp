@@ -0,0 +1,276 @@
+﻿// height_pack.cpp
+#include "height_pack.h"
+#include "stencil_kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// 与 stencil_kernels.cpp 相同：关闭乘加融合，保证 SIMD 版与标量版逐位一致
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PACK_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define PACK_TARGET(isa)
+#else
+#define PACK_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+bool parseHeightFormat(const char* name, HeightFormat& format) {
+    const HeightFormat all[] = { HeightFormat::F32, HeightFormat::F16, HeightFormat::Q16 };
+    for (HeightFormat candidate : all) {
+        if (std::strcmp(name, heightFormatName(candidate)) == 0) {
+            format = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* heightFormatName(HeightFormat format) {
+    switch (format) {
+    case HeightFormat::F16: return "f16";
+    case HeightFormat::Q16: return "q16";
+    default:                return "f32";
+    }
+}
+
+int heightFormatBytes(HeightFormat format) {
+    return format == HeightFormat::F32 ? 4 : 2;
+}
+
+// --- 标量版 ---
+// float -> half，就近舍入到偶数，溢出为无穷大，NaN 保持为 NaN（与 vcvtps2ph 相同）
+static uint16_t floatToHalf(float value) {
+    uint32_t f;
+    std::memcpy(&f, &value, sizeof(f));
+    uint32_t sign = (f >> 16) & 0x8000u;
+    uint32_t absBits = f & 0x7FFFFFFFu;
+    if (absBits >= 0x7F800000u) { // Inf / NaN
+        return uint16_t(sign | 0x7C00u | (absBits > 0x7F800000u ? 0x200u | ((absBits >> 13) & 0x3FFu) : 0u));
+    }
+    if (absBits >= 0x477FF000u) { // 舍入后超出半精度最大值 65504
+        return uint16_t(sign | 0x7C00u);
+    }
+    if (absBits < 0x38800000u) { // 结果是非规格化数或 0：按 2^-24 的步长就近舍入
+        if (absBits < 0x33000000u) return uint16_t(sign); // 小于最小非规格化数的一半
+        uint32_t mant = (absBits & 0x7FFFFFu) | 0x800000u;
+        int shift = 126 - int(absBits >> 23); // 14 … 24
+        uint32_t half = mant >> shift;
+        uint32_t rest = mant & ((1u << shift) - 1u);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1u))) ++half;
+        return uint16_t(sign | half);
+    }
+    uint32_t half = ((absBits - 0x38000000u) >> 13); // 重新偏置指数，截掉低 13 位尾数
+    uint32_t rest = absBits & 0x1FFFu;
+    if (rest > 0x1000u || (rest == 0x1000u && (half & 1u))) ++half; // 进位可能进到指数，结果仍然正确
+    return uint16_t(sign | half);
+}
+
+float unpackHalf(uint16_t h) {
+    uint32_t sign = uint32_t(h & 0x8000u) << 16;
+    uint32_t exp = (h >> 10) & 0x1Fu;
+    uint32_t mant = h & 0x3FFu;
+    float value;
+    if (exp == 0) {
+        value = std::ldexp(float(mant), -24);
+    }
+    else if (exp == 31) {
+        value = mant ? NAN : INFINITY;
+    }
+    else {
+        value = std::ldexp(float(mant | 0x400u), int(exp) - 25);
+    }
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    bits |= sign;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static void packHalfScalar(uint16_t* dst, const float* src, int count) {
+    for (int i = 0; i < count; ++i) {
+        dst[i] = floatToHalf(src[i]);
+    }
+}
+
+static void packUnorm16Scalar(uint16_t* dst, const float* src, int count, float lo, float k) {
+    for (int i = 0; i < count; ++i) {
+        float t = (src[i] - lo) * k;
+        t = std::min(std::max(t, 0.0f), 65535.0f);
+        dst[i] = uint16_t(std::nearbyint(t)); // 默认舍入模式：就近舍入到偶数，与 cvtps2dq 相同
+    }
+}
+
+static float maxAbsScalar(const float* src, int count) {
+    float m = 0.0f;
+    for (int i = 0; i < count; ++i) {
+        m = std::max(m, std::fabs(src[i]));
+    }
+    return m;
+}
+
+static float maxAbsDeltaScalar(const float* a, const float* b, int count) {
+    float m = 0.0f;
+    for (int i = 0; i < count; ++i) {
+        m = std::max(m, std::fabs(a[i] - b[i]));
+    }
+    return m;
+}
+
+#ifdef PACK_X86
+// --- F16C：每次 8 个 ---
+PACK_TARGET("avx2,f16c")
+static void packHalfF16C(uint16_t* dst, const float* src, int count) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), h);
+    }
+    for (; i < count; ++i) { // 尾部也用 F16C（单个元素），避免与标量版的非规格化数处理不一致
+        __m128i h = _mm_cvtps_ph(_mm_set_ss(src[i]), _MM_FROUND_TO_NEAREST_INT);
+        dst[i] = uint16_t(_mm_extract_epi16(h, 0));
+    }
+}
+
+// --- AVX2：每次 16 个 ---
+PACK_TARGET("avx2")
+static void packUnorm16AVX2(uint16_t* dst, const float* src, int count, float lo, float k) {
+    const __m256 vlo = _mm256_set1_ps(lo), vk = _mm256_set1_ps(k);
+    const __m256 zero = _mm256_setzero_ps(), top = _mm256_set1_ps(65535.0f);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256 a = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(src + i), vlo), vk);
+        __m256 b = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(src + i + 8), vlo), vk);
+        a = _mm256_min_ps(_mm256_max_ps(a, zero), top);
+        b = _mm256_min_ps(_mm256_max_ps(b, zero), top);
+        // packus 在每个 128 位通道内交错两个输入，permute 把 64 位块排回原来的顺序
+        __m256i packed = _mm256_packus_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+        packed = _mm256_permute4x64_epi64(packed, 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), packed);
+    }
+    for (; i < count; ++i) {
+        float t = (src[i] - lo) * k;
+        t = std::min(std::max(t, 0.0f), 65535.0f);
+        dst[i] = uint16_t(std::nearbyint(t));
+    }
+}
+
+PACK_TARGET("avx2")
+static float maxAbsAVX2(const float* src, int count) {
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    __m256 m = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        m = _mm256_max_ps(m, _mm256_and_ps(_mm256_loadu_ps(src + i), absMask));
+    }
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, m);
+    float result = 0.0f;
+    for (float lane : lanes) result = std::max(result, lane);
+    for (; i < count; ++i) result = std::max(result, std::fabs(src[i]));
+    return result;
+}
+
+PACK_TARGET("avx2")
+static float maxAbsDeltaAVX2(const float* a, const float* b, int count) {
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    __m256 m = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        m = _mm256_max_ps(m, _mm256_and_ps(d, absMask));
+    }
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, m);
+    float result = 0.0f;
+    for (float lane : lanes) result = std::max(result, lane);
+    for (; i < count; ++i) result = std::max(result, std::fabs(a[i] - b[i]));
+    return result;
+}
+
+static bool detectF16C() {
+    int regs[4];
+#if defined(_MSC_VER)
+    __cpuid(regs, 1);
+#else
+    unsigned a, b, c, d;
+    __cpuid(1, a, b, c, d);
+    regs[2] = int(c);
+#endif
+    return (regs[2] & (1 << 29)) != 0;
+}
+#endif // PACK_X86
+
+// AVX2 的可用性（含操作系统支持）沿用模板内核的检测结果，--isa scalar 时这里也走标量版
+static bool useAVX2() {
+#ifdef PACK_X86
+    return static_cast<int>(stencilIsa()) >= static_cast<int>(StencilIsa::AVX2);
+#else
+    return false;
+#endif
+}
+
+void packHeightsHalf(uint16_t* dst, const float* src, int count) {
+#ifdef PACK_X86
+    static const bool f16c = detectF16C();
+    if (f16c && useAVX2()) {
+        packHalfF16C(dst, src, count);
+        return;
+    }
+#endif
+    packHalfScalar(dst, src, count);
+}
+
+void packHeightsUnorm16(uint16_t* dst, const float* src, int count, float lo, float hi) {
+    float k = 65535.0f / (hi - lo);
+#ifdef PACK_X86
+    if (useAVX2()) {
+        packUnorm16AVX2(dst, src, count, lo, k);
+        return;
+    }
+#endif
+    packUnorm16Scalar(dst, src, count, lo, k);
+}
+
+float maxAbsHeight(const float* src, int count) {
+#ifdef PACK_X86
+    if (useAVX2()) {
+        return maxAbsAVX2(src, count);
+    }
+#endif
+    return maxAbsScalar(src, count);
+}
+
+float maxAbsDelta(const float* a, const float* b, int count) {
+#ifdef PACK_X86
+    if (useAVX2()) {
+        return maxAbsDeltaAVX2(a, b, count);
+    }
+#endif
+    return maxAbsDeltaScalar(a, b, count);
+}
+
+float halfErrorBound(float maxAbs) {
+    // 规格化范围内相对误差不超过 2^-11；非规格化范围步长 2^-24，误差不超过 2^-25
+    return std::max(maxAbs * std::ldexp(1.0f, -11), std::ldexp(1.0f, -25));
+}
+
+float unorm16ErrorBound(float lo, float hi) {
+    // 半个量化步长，加上编码、解码各自的 float 舍入（按量程的 4 个 ulp 计）
+    float magnitude = std::max(std::fabs(lo), std::fabs(hi));
+    return (hi - lo) / 65535.0f * 0.5f + std::ldexp(magnitude, -21);
+}
@@ -0,0 +1,29 @@
+﻿// height_pack.h
+// 高度上传格式：float（32 位）、fp16、16 位定点量化。上传量和暂存内存减半，误差有确定的上界。
+// 转换在写入上传缓冲区时逐行完成，F16C / AVX2 版本与标量版结果逐位一致（跟随 setStencilIsa() 的选择）。
+#pragma once
+#include <cstdint>
+
+enum class HeightFormat {
+    F32, // 原始 float
+    F16, // IEEE 半精度（F16C：vcvtps2ph，就近舍入到偶数）
+    Q16  // 16 位定点：[lo, hi] 线性映射到 0…65535（GL_R16 / 归一化 GL_UNSIGNED_SHORT），着色器里反变换
+};
+
+bool parseHeightFormat(const char* name, HeightFormat& format); // "f32" / "f16" / "q16"
+const char* heightFormatName(HeightFormat format);
+int heightFormatBytes(HeightFormat format);
+
+// 半精度：dst[i] = half(src[i])
+void packHeightsHalf(uint16_t* dst, const float* src, int count);
+float unpackHalf(uint16_t h);
+
+// 定点：dst[i] = round((clamp(src[i], lo, hi) - lo) * 65535 / (hi - lo))，解码为 q / 65535 * (hi - lo) + lo
+void packHeightsUnorm16(uint16_t* dst, const float* src, int count, float lo, float hi);
+
+float maxAbsHeight(const float* src, int count); // 用来确定每帧的量化范围 [-max, max]
+float maxAbsDelta(const float* a, const float* b, int count); // max |a[i] − b[i]|，用于判断分块是否需要重新上传
+
+// 误差上界（绝对值）
+float halfErrorBound(float maxAbs);             // 半精度：最大值的半个 ulp（相对误差 2^-11），下限为非规格化步长的一半
+float unorm16ErrorBound(float lo, float hi);    // 定点：半个量化步长（另加编解码的 float 舍入余量）
@@ -0,0 +1,223 @@
+﻿// height_pyramid.cpp
+#include "height_pyramid.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cfloat>
+
+void HeightPyramid::resize(int w, int h, float heightSlack) {
+    width = w;
+    height = h;
+    slack = heightSlack;
+    levelWidth.clear();
+    levelHeight.clear();
+    levelOffset.clear();
+    size_t total = 0;
+    int lw = std::max(w - 1, 1), lh = std::max(h - 1, 1);
+    for (;;) {
+        levelWidth.push_back(lw);
+        levelHeight.push_back(lh);
+        levelOffset.push_back(total);
+        total += size_t(lw) * lh;
+        if (lw == 1 && lh == 1) break;
+        lw = (lw + 1) / 2;
+        lh = (lh + 1) / 2;
+    }
+    minHeight.assign(total, -FLT_MAX); // 更新之前保守地视为覆盖所有高度
+    maxHeight.assign(total, FLT_MAX);
+}
+
+// 重算第 level 层的 [i0, i1) × [j0, j1) 项：第 0 层取格子四个角，之上取下一层的 2×2 项
+void HeightPyramid::buildCells(int level, int i0, int i1, int j0, int j1, const float* heights, int stride) {
+    const int lw = levelWidth[level];
+    float* outMin = minHeight.data() + levelOffset[level];
+    float* outMax = maxHeight.data() + levelOffset[level];
+    if (level == 0) {
+        for (int j = j0; j < j1; ++j) {
+            const float* row0 = heights + size_t(j) * stride;
+            const float* row1 = row0 + stride;
+            for (int i = i0; i < i1; ++i) {
+                float lo = std::min(std::min(row0[i], row0[i + 1]), std::min(row1[i], row1[i + 1]));
+                float hi = std::max(std::max(row0[i], row0[i + 1]), std::max(row1[i], row1[i + 1]));
+                outMin[size_t(j) * lw + i] = lo - slack;
+                outMax[size_t(j) * lw + i] = hi + slack;
+            }
+        }
+        return;
+    }
+    const int cw = levelWidth[level - 1], ch = levelHeight[level - 1];
+    const float* inMin = minHeight.data() + levelOffset[level - 1];
+    const float* inMax = maxHeight.data() + levelOffset[level - 1];
+    for (int j = j0; j < j1; ++j) {
+        const int cj0 = 2 * j, cj1 = std::min(2 * j + 2, ch);
+        for (int i = i0; i < i1; ++i) {
+            const int ci0 = 2 * i, ci1 = std::min(2 * i + 2, cw);
+            float lo = FLT_MAX, hi = -FLT_MAX;
+            for (int cj = cj0; cj < cj1; ++cj) {
+                for (int ci = ci0; ci < ci1; ++ci) {
+                    lo = std::min(lo, inMin[size_t(cj) * cw + ci]);
+                    hi = std::max(hi, inMax[size_t(cj) * cw + ci]);
+                }
+            }
+            outMin[size_t(j) * lw + i] = lo;
+            outMax[size_t(j) * lw + i] = hi;
+        }
+    }
+}
+
+void HeightPyramid::rebuild(const float* heights, int stride, ThreadPool* pool) {
+    for (int level = 0; level < levels(); ++level) {
+        const int lw = levelWidth[level], lh = levelHeight[level];
+        auto rows = [&](int t, int n) {
+            buildCells(level, 0, lw, lh * t / n, lh * (t + 1) / n, heights, stride);
+        };
+        if (pool && pool->size() > 1 && lh >= 4 * pool->size()) {
+            pool->run(rows);
+        }
+        else {
+            rows(0, 1);
+        }
+    }
+}
+
+void HeightPyramid::update(const float* heights, int stride, const std::vector<DirtyRect>& rects) {
+    for (const DirtyRect& rect : rects) {
+        // 顶点 [x0, x1) 被格子 [x0 - 1, x1) 用到
+        int i0 = std::max(rect.x0 - 1, 0), i1 = std::min(rect.x1, levelWidth[0]);
+        int j0 = std::max(rect.z0 - 1, 0), j1 = std::min(rect.z1, levelHeight[0]);
+        if (i0 >= i1 || j0 >= j1) continue;
+        buildCells(0, i0, i1, j0, j1, heights, stride);
+        for (int level = 1; level < levels(); ++level) {
+            i0 >>= 1;
+            j0 >>= 1;
+            i1 = ((i1 - 1) >> 1) + 1;
+            j1 = ((j1 - 1) >> 1) + 1;
+            buildCells(level, i0, i1, j0, j1, heights, stride);
+        }
+    }
+}
+
+namespace {
+
+// 射线与轴对齐盒子的相交区间（slab 法），invDir 为方向的倒数
+bool intersectBox(const glm::vec3& origin, const glm::vec3& invDir, const glm::vec3& boxMin, const glm::vec3& boxMax,
+                  float tMin, float tMax, float& tNear, float& tFar) {
+    glm::vec3 t0 = (boxMin - origin) * invDir;
+    glm::vec3 t1 = (boxMax - origin) * invDir;
+    glm::vec3 lo = glm::min(t0, t1), hi = glm::max(t0, t1);
+    tNear = std::max(std::max(lo.x, lo.y), std::max(lo.z, tMin));
+    tFar = std::min(std::min(hi.x, hi.y), std::min(hi.z, tMax));
+    return tNear <= tFar;
+}
+
+// Möller-Trumbore：射线与三角形 (a, b, c) 的交点参数，不相交时返回 false
+bool intersectTriangle(const glm::vec3& origin, const glm::vec3& dir,
+                       const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, float& t) {
+    glm::vec3 e1 = b - a, e2 = c - a;
+    glm::vec3 p = glm::cross(dir, e2);
+    float det = glm::dot(e1, p);
+    if (std::abs(det) < 1e-12f) return false;
+    float inv = 1.0f / det;
+    glm::vec3 s = origin - a;
+    float u = glm::dot(s, p) * inv;
+    if (u < 0.0f || u > 1.0f) return false;
+    glm::vec3 q = glm::cross(s, e1);
+    float v = glm::dot(dir, q) * inv;
+    if (v < 0.0f || u + v > 1.0f) return false;
+    t = glm::dot(e2, q) * inv;
+    return true;
+}
+
+// 射线与格子 (x, z) 的两个三角形的最近交点，与 emitQuad() 的剖分相同：
+// (x, z) (x+1, z) (x, z+1) 和 (x+1, z) (x+1, z+1) (x, z+1)
+bool intersectCell(const glm::vec3& origin, const glm::vec3& dir, float maxT,
+                   const float* heights, int stride, int x, int z, float& t) {
+    const float* row0 = heights + size_t(z) * stride;
+    const float* row1 = row0 + stride;
+    glm::vec3 v00(float(x), row0[x], float(z)), v10(float(x + 1), row0[x + 1], float(z));
+    glm::vec3 v01(float(x), row1[x], float(z + 1)), v11(float(x + 1), row1[x + 1], float(z + 1));
+    float best = FLT_MAX, hit;
+    if (intersectTriangle(origin, dir, v00, v10, v01, hit) && hit >= 0.0f && hit <= maxT) best = hit;
+    if (intersectTriangle(origin, dir, v10, v11, v01, hit) && hit >= 0.0f && hit <= maxT) best = std::min(best, hit);
+    if (best == FLT_MAX) return false;
+    t = best;
+    return true;
+}
+
+} // namespace
+
+bool HeightPyramid::raycast(const glm::vec3& origin, const glm::vec3& dir, float maxT,
+                            const float* heights, int stride, float& t, int* visitedNodes) const {
+    int visited = 0;
+    if (visitedNodes) *visitedNodes = 0;
+    if (width < 2 || height < 2) return false;
+    const float huge = 1e30f;
+    glm::vec3 invDir(dir.x != 0.0f ? 1.0f / dir.x : huge,
+                     dir.y != 0.0f ? 1.0f / dir.y : huge,
+                     dir.z != 0.0f ? 1.0f / dir.z : huge);
+
+    // 节点的包围盒：xz 覆盖 [i, i + 1) << level 个格子（裁剪到网格内），y 为该项的最小 / 最大高度
+    auto nodeBox = [&](int level, int i, int j, float tMin, float tMax, float& tNear, float& tFar) {
+        const size_t index = levelOffset[level] + size_t(j) * levelWidth[level] + i;
+        const int size = 1 << level;
+        glm::vec3 boxMin(float(i * size), minHeight[index], float(j * size));
+        glm::vec3 boxMax(float(std::min((i + 1) * size, width - 1)), maxHeight[index],
+                         float(std::min((j + 1) * size, height - 1)));
+        return intersectBox(origin, invDir, boxMin, boxMax, tMin, tMax, tNear, tFar);
+    };
+
+    // 深度优先、从近到远：同一节点的子节点在 xz 上互不重叠，按射线进入的先后出栈，第一个命中就是最近的交点
+    struct Entry { int level, i, j; float tNear; };
+    Entry stack[4 * 32];
+    int top = 0;
+    float rootNear, rootFar;
+    if (!nodeBox(levels() - 1, 0, 0, 0.0f, maxT, rootNear, rootFar)) return false;
+    stack[top++] = { levels() - 1, 0, 0, rootNear };
+    while (top > 0) {
+        const Entry node = stack[--top];
+        ++visited;
+        if (node.level == 0) {
+            if (intersectCell(origin, dir, maxT, heights, stride, node.i, node.j, t)) {
+                if (visitedNodes) *visitedNodes = visited;
+                return true;
+            }
+            continue;
+        }
+
+        // 与射线相交的子节点按进入时刻从远到近入栈，近的先出栈
+        Entry children[4];
+        int count = 0;
+        const int childLevel = node.level - 1;
+        for (int dj = 0; dj < 2; ++dj) {
+            for (int di = 0; di < 2; ++di) {
+                const int ci = 2 * node.i + di, cj = 2 * node.j + dj;
+                if (ci >= levelWidth[childLevel] || cj >= levelHeight[childLevel]) continue;
+                float cNear, cFar;
+                if (!nodeBox(childLevel, ci, cj, 0.0f, maxT, cNear, cFar)) continue;
+                int k = count++;
+                while (k > 0 && children[k - 1].tNear < cNear) {
+                    children[k] = children[k - 1];
+                    --k;
+                }
+                children[k] = { childLevel, ci, cj, cNear };
+            }
+        }
+        for (int k = 0; k < count; ++k) {
+            stack[top++] = children[k];
+        }
+    }
+    if (visitedNodes) *visitedNodes = visited;
+    return false;
+}
+
+bool HeightPyramid::raycastAllCells(const glm::vec3& origin, const glm::vec3& dir, float maxT,
+                                    const float* heights, int stride, float& t) const {
+    float best = FLT_MAX, hit;
+    for (int z = 0; z < height - 1; ++z) {
+        for (int x = 0; x < width - 1; ++x) {
+            if (intersectCell(origin, dir, maxT, heights, stride, x, z, hit)) best = std::min(best, hit);
+        }
+    }
+    if (best == FLT_MAX) return false;
+    t = best;
+    return true;
+}
@@ -0,0 +1,42 @@
+﻿// height_pyramid.h
+// 高度场的最小 / 最大值金字塔，用于射线与真实（有起伏的）水面求交。第 0 层每个格子一项（四个角的最小 / 最大高度），
+// 之后每层把 2×2 项合并成一项，直到只剩一项。射线从顶层往下走，包围盒与射线不相交的整块直接跳过，
+// 只有真正擦到的格子才和两个三角形求交（与 mesh_indices.cpp 的三角剖分一致），平均只访问 O(log + 射线经过的格子) 个节点。
+// 所有坐标都是网格坐标：x / z 以格子为单位（顶点 (x, z) 在整数处），y 为模拟高度。
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "dirty_tiles.h"
+
+class ThreadPool;
+
+class HeightPyramid {
+public:
+    // 宽 width、高 height 个顶点的网格。slack 为每一项的最小 / 最大值额外放宽的量：
+    // 求交用的高度与最近一次更新时的高度相差不超过 slack 时结果仍然正确（例如只按脏区更新时取脏区阈值）
+    void resize(int width, int height, float slack = 0.0f);
+
+    // 整张重建（有线程池时按行并行）
+    void rebuild(const float* heights, int stride, ThreadPool* pool);
+    // 增量更新：只重算顶点矩形 rects 覆盖到的格子，以及它们在上面各层的祖先
+    void update(const float* heights, int stride, const std::vector<DirtyRect>& rects);
+
+    // 射线 origin + t · dir（t ∈ [0, maxT]）与水面的最近交点。heights 必须是最近一次更新用的高度场
+    // （或与它相差不超过 slack）。只读，可以在多个线程上同时查询；visitedNodes 非空时返回访问的节点数
+    bool raycast(const glm::vec3& origin, const glm::vec3& dir, float maxT,
+                 const float* heights, int stride, float& t, int* visitedNodes = nullptr) const;
+    // 逐格求交的参考实现，O(W·H)，只用于校验
+    bool raycastAllCells(const glm::vec3& origin, const glm::vec3& dir, float maxT,
+                         const float* heights, int stride, float& t) const;
+
+    int levels() const { return int(levelWidth.size()); }
+
+private:
+    void buildCells(int level, int i0, int i1, int j0, int j1, const float* heights, int stride);
+
+    int width = 0, height = 0;
+    float slack = 0.0f;
+    std::vector<int> levelWidth, levelHeight; // 每层的项数（第 0 层为 (width - 1) × (height - 1) 个格子）
+    std::vector<size_t> levelOffset;
+    std::vector<float> minHeight, maxHeight;  // 各层依次排列，行优先
+};
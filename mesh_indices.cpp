@@ -0,0 +1,76 @@
+﻿// mesh_indices.cpp
+#include "mesh_indices.h"
+#include <algorithm>
+
+static void emitQuad(std::vector<unsigned int>& indices, int width, int x, int z) {
+    unsigned int i = unsigned(z) * unsigned(width) + unsigned(x);
+    indices.push_back(i);
+    indices.push_back(i + 1);
+    indices.push_back(i + width);
+
+    indices.push_back(i + 1);
+    indices.push_back(i + width + 1);
+    indices.push_back(i + width);
+}
+
+std::vector<unsigned int> buildGridIndices(int width, int height, GridIndexOrder order,
+                                           int stripeWidth, int cacheSize) {
+    std::vector<unsigned int> indices;
+    if (width < 2 || height < 2) {
+        return indices;
+    }
+    indices.reserve(size_t(width - 1) * (height - 1) * 6);
+
+    if (order == GridIndexOrder::Rows) {
+        for (int z = 0; z < height - 1; ++z)
+            for (int x = 0; x < width - 1; ++x)
+                emitQuad(indices, width, x, z);
+        return indices;
+    }
+
+    // 竖条：条内每一行用到上一行的 stripeWidth + 1 个顶点，只要它们还没被挤出缓存就能全部命中
+    int stripe = stripeWidth > 0 ? stripeWidth : bestStripeWidth(cacheSize);
+    for (int x0 = 0; x0 < width - 1; x0 += stripe) {
+        int x1 = std::min(x0 + stripe, width - 1);
+        for (int z = 0; z < height - 1; ++z)
+            for (int x = x0; x < x1; ++x)
+                emitQuad(indices, width, x, z);
+    }
+    return indices;
+}
+
+int bestStripeWidth(int cacheSize) {
+    // 条宽只和缓存大小有关，用一个足够宽、足够高的样本网格模拟即可
+    const int sampleWidth = 4 * cacheSize + 1, sampleHeight = 32;
+    int best = 1;
+    double bestAcmr = 1e9;
+    for (int stripe = 2; stripe <= cacheSize; ++stripe) {
+        std::vector<unsigned int> indices = buildGridIndices(sampleWidth, sampleHeight, GridIndexOrder::Stripes, stripe);
+        double acmr = simulateVertexCache(indices, sampleWidth * sampleHeight, cacheSize).acmr;
+        if (acmr < bestAcmr) {
+            bestAcmr = acmr;
+            best = stripe;
+        }
+    }
+    return best;
+}
+
+VertexCacheStats simulateVertexCache(const std::vector<unsigned int>& indices, int vertexCount, int cacheSize) {
+    // FIFO：命中不改变顺序，未命中时挤掉最早进入的一项。
+    // stamp[v] 记录顶点 v 进入缓存时的未命中序号，序号差小于 cacheSize 说明它还在缓存里
+    std::vector<long long> stamp(vertexCount, -1);
+    std::vector<char> used(vertexCount, 0);
+    long long misses = 0;
+    for (unsigned int v : indices) {
+        if (stamp[v] < 0 || misses - stamp[v] >= cacheSize) {
+            stamp[v] = misses++;
+        }
+        used[v] = 1;
+    }
+    long long triangles = (long long)indices.size() / 3;
+    long long usedVertices = std::count(used.begin(), used.end(), 1);
+    VertexCacheStats stats;
+    stats.acmr = triangles > 0 ? double(misses) / triangles : 0.0;
+    stats.atvr = usedVertices > 0 ? double(misses) / usedVertices : 0.0;
+    return stats;
+}
@@ -0,0 +1,28 @@
+﻿// mesh_indices.h
+// 规则网格的三角形索引生成，以及顶点后变换缓存（post-transform vertex cache）的命中率统计。
+// 按行生成时，宽网格下一行的顶点早已被挤出缓存，几乎每个顶点都要重新执行顶点着色器（ACMR ≈ 1）；
+// 按竖条（stripe）生成时，每条宽度刚好让上一行的顶点还留在缓存里，ACMR 接近理论下限 0.5。
+#pragma once
+#include <vector>
+
+enum class GridIndexOrder {
+    Rows,    // 逐行（原来的顺序）
+    Stripes  // 竖条：每条 stripeWidth 个格子宽，条内逐行
+};
+
+struct VertexCacheStats {
+    double acmr; // 平均每个三角形的缓存未命中数（顶点着色器执行次数 / 三角形数），越低越好，下限约 0.5
+    double atvr; // 未命中数 / 实际用到的顶点数，1 表示每个顶点只变换一次
+};
+
+// 宽 width、高 height 个顶点的网格，每个格子两个三角形（与 initGrid() 原来的绕序相同）。
+// stripeWidth <= 0 时按 cacheSize 自动选择。默认按 16 项的缓存选条宽：缓存更大时照样全部命中，
+// 反过来按 32 项选的条宽放到 16 项的缓存上会退化到比逐行还差
+std::vector<unsigned int> buildGridIndices(int width, int height, GridIndexOrder order,
+                                           int stripeWidth = 0, int cacheSize = 16);
+
+// 给定 FIFO 缓存大小下自动选出的竖条宽度（在小样本网格上模拟挑 ACMR 最低的）
+int bestStripeWidth(int cacheSize);
+
+// 模拟 cacheSize 项的 FIFO 顶点缓存
+VertexCacheStats simulateVertexCache(const std::vector<unsigned int>& indices, int vertexCount, int cacheSize = 16);
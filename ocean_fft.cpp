@@ -0,0 +1,170 @@
+﻿// ocean_fft.cpp
+#include "ocean_fft.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+const float GRAVITY = 9.81f;
+const float PI = 3.14159265358979f;
+const float PHILLIPS_ALPHA = 0.0081f;   // Phillips 常数
+const float JONSWAP_GAMMA = 3.3f;       // 谱峰增强因子
+const float OPPOSING_WAVES = 0.07f;     // 逆风传播的波保留的能量比例
+
+// 方向分布 cos²θ / π（整个圆上积分为 1），逆风一侧再压低
+float directionalSpread(float kx, float kz, float k, float windX, float windZ) {
+    float c = (kx * windX + kz * windZ) / k;
+    float spread = c * c / PI;
+    return c < 0.0f ? spread * OPPOSING_WAVES : spread;
+}
+
+// 波矢空间的能量谱密度 Ψ(k)（米⁴）：∫Ψ d²k 为高度的方差。两种谱在高频都趋于 α/2 · k⁻⁴
+float spectrumDensity(const OceanParams& params, float kx, float kz, float windX, float windZ) {
+    const float k = std::sqrt(kx * kx + kz * kz);
+    if (k < 1e-6f) {
+        return 0.0f;
+    }
+    const float u = params.windSpeed;
+    const float spread = directionalSpread(kx, kz, k, windX, windZ);
+    if (params.spectrum == OceanSpectrum::Phillips) {
+        const float peak = u * u / GRAVITY; // 该风速下最大的波长尺度
+        const float k2 = k * k;
+        return 0.5f * PHILLIPS_ALPHA / (k2 * k2) * std::exp(-1.0f / (k2 * peak * peak)) * spread;
+    }
+    // JONSWAP：S(ω) = α g² ω⁻⁵ exp(-5/4 (ωp/ω)⁴) γ^r，换到波矢空间 Ψ = S(ω) · dω/dk / k · D(θ)
+    const float fetch = params.fetch;
+    const float alpha = 0.076f * std::pow(u * u / (fetch * GRAVITY), 0.22f);
+    const float omegaPeak = 22.0f * std::pow(GRAVITY * GRAVITY / (u * fetch), 1.0f / 3.0f);
+    const float omega = std::sqrt(GRAVITY * k);
+    const float sigma = omega <= omegaPeak ? 0.07f : 0.09f;
+    const float d = (omega - omegaPeak) / (sigma * omegaPeak);
+    const float ratio = omegaPeak / omega;
+    const float s = alpha * GRAVITY * GRAVITY / std::pow(omega, 5.0f) * std::exp(-1.25f * ratio * ratio * ratio * ratio)
+                  * std::pow(JONSWAP_GAMMA, std::exp(-0.5f * d * d));
+    return s * (GRAVITY / (2.0f * omega)) / k * spread;
+}
+
+// 下标 m ∈ [0, n) 对应的有符号波数序号：0, 1, …, n/2 − 1, −n/2, …, −1（与 FFT 输出顺序一致）
+int signedIndex(int m, int n) {
+    return m < n / 2 ? m : m - n;
+}
+
+} // namespace
+
+OceanFft::OceanFft(const OceanParams& params)
+    : n(params.size), halfWidth(params.size / 2 + 1), choppiness(params.choppiness) {
+    const size_t spectrumCount = size_t(n) * halfWidth;
+    modes = static_cast<Mode*>(fftwf_malloc(sizeof(Mode) * spectrumCount));
+    spectra = fftwf_alloc_complex(spectrumCount * FIELD_COUNT);
+    fields = fftwf_alloc_real(size_t(n) * n * FIELD_COUNT);
+
+    // 先制定计划：实测会改写输入输出数组，所以在填数据之前做。
+    // 五个场共用一个批量计划，n0 = z（行），n1 = x（最内维）
+    const int dims[2] = { n, n };
+    const std::string key = "c2r-" + std::to_string(n) + "x" + std::to_string(n) + "x" + std::to_string(FIELD_COUNT);
+    plan = fftwPlanCached(key, params.planRigor, [&](unsigned flags) {
+        return fftwf_plan_many_dft_c2r(2, dims, FIELD_COUNT,
+                                       spectra, nullptr, 1, int(spectrumCount),
+                                       fields, nullptr, 1, n * n, flags);
+    }, &planning);
+
+    // 每个波矢一对独立的标准正态随机数（Box-Muller，直接用 mt19937 的输出，换标准库也能复现）
+    std::mt19937 rng(params.seed);
+    auto uniform = [&rng]() { return (float(rng() >> 8) + 0.5f) * (1.0f / 16777216.0f); };
+    std::vector<float> gaussians(size_t(n) * n * 2);
+    for (size_t i = 0; i < gaussians.size(); i += 2) {
+        float r = std::sqrt(-2.0f * std::log(uniform()));
+        float a = 2.0f * PI * uniform();
+        gaussians[i] = r * std::cos(a);
+        gaussians[i + 1] = r * std::sin(a);
+    }
+
+    // h0(k) = ξ · √(Ψ(k) / 2) · Δk，ξ 为实部虚部方差各 1/2 的复高斯数。这样 h(k, t) = h0(k) e^{iωt} + conj(h0(−k)) e^{−iωt}
+    // 的期望模方为 Ψ(k) Δk²，逆变换后高度的方差为 ∫Ψ d²k
+    const float dk = 2.0f * PI / params.patchLength;
+    const float windX = std::cos(params.windDirection), windZ = std::sin(params.windDirection);
+    auto h0 = [&](int mz, int mx, float& re, float& im) {
+        float kx = signedIndex(mx, n) * dk, kz = signedIndex(mz, n) * dk;
+        float amplitude = std::sqrt(0.5f * spectrumDensity(params, kx, kz, windX, windZ)) * dk * 0.70710678f;
+        const float* g = &gaussians[(size_t(mz) * n + mx) * 2];
+        re = g[0] * amplitude;
+        im = g[1] * amplitude;
+    };
+    for (int mz = 0; mz < n; ++mz) {
+        for (int mx = 0; mx < halfWidth; ++mx) {
+            Mode& mode = modes[size_t(mz) * halfWidth + mx];
+            // 奈奎斯特行 / 列的 ±k 落在同一个采样上，无法保持共轭对称，直接置零
+            if (mz == n / 2 || mx == n / 2) {
+                mode = Mode{};
+                continue;
+            }
+            mode.kx = signedIndex(mx, n) * dk;
+            mode.kz = signedIndex(mz, n) * dk;
+            float k = std::sqrt(mode.kx * mode.kx + mode.kz * mode.kz);
+            mode.invK = k > 0.0f ? 1.0f / k : 0.0f;
+            mode.omega = std::sqrt(GRAVITY * k);
+            h0(mz, mx, mode.h0Re, mode.h0Im);
+            float re, im;
+            h0((n - mz) % n, (n - mx) % n, re, im);
+            mode.h0mRe = re;
+            mode.h0mIm = -im;
+        }
+    }
+}
+
+OceanFft::~OceanFft() {
+    if (plan) fftwf_destroy_plan(plan);
+    fftwf_free(fields);
+    fftwf_free(spectra);
+    fftwf_free(modes);
+}
+
+void OceanFft::fillSpectrumRows(int z0, int z1, float time) {
+    const size_t spectrumCount = size_t(n) * halfWidth;
+    fftwf_complex* height = spectra;
+    fftwf_complex* dispX = spectra + spectrumCount;
+    fftwf_complex* dispZ = spectra + 2 * spectrumCount;
+    fftwf_complex* gradX = spectra + 3 * spectrumCount;
+    fftwf_complex* gradZ = spectra + 4 * spectrumCount;
+    for (size_t i = size_t(z0) * halfWidth; i < size_t(z1) * halfWidth; ++i) {
+        const Mode& mode = modes[i];
+        const float c = std::cos(mode.omega * time), s = std::sin(mode.omega * time);
+        // h = h0 e^{iωt} + conj(h0(−k)) e^{−iωt}
+        const float re = (mode.h0Re + mode.h0mRe) * c - (mode.h0Im - mode.h0mIm) * s;
+        const float im = (mode.h0Im + mode.h0mIm) * c + (mode.h0Re - mode.h0mRe) * s;
+        height[i][0] = re;
+        height[i][1] = im;
+        // 位移 D = i · k/|k| · h · λ（与 Gerstner 波同号：波峰两侧的点向波峰聚拢，λ > 0 得到尖的波峰），梯度 ∇h = i · k · h
+        const float dx = choppiness * mode.kx * mode.invK, dz = choppiness * mode.kz * mode.invK;
+        dispX[i][0] = -dx * im;
+        dispX[i][1] = dx * re;
+        dispZ[i][0] = -dz * im;
+        dispZ[i][1] = dz * re;
+        gradX[i][0] = -mode.kx * im;
+        gradX[i][1] = mode.kx * re;
+        gradZ[i][0] = -mode.kz * im;
+        gradZ[i][1] = mode.kz * re;
+    }
+}
+
+void OceanFft::synthesize(float time) {
+    auto start = std::chrono::steady_clock::now();
+    if (pool && pool->size() > 1) {
+        pool->run([&](int t, int count) {
+            fillSpectrumRows(n * t / count, n * (t + 1) / count, time);
+        });
+    }
+    else {
+        fillSpectrumRows(0, n, time);
+    }
+    auto mid = std::chrono::steady_clock::now();
+    fftwf_execute(plan); // FFTW 的逆变换不做归一化，正好是 Σ h(k) e^{ik·x}
+    auto end = std::chrono::steady_clock::now();
+    lastSpectrumMs = std::chrono::duration<double, std::milli>(mid - start).count();
+    lastFftMs = std::chrono::duration<double, std::milli>(end - mid).count();
+}
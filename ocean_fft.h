@@ -0,0 +1,79 @@
+﻿// ocean_fft.h
+// 频谱海面（Tessendorf 2001）：按 Phillips 或 JONSWAP 谱生成一次初始频谱 h0(k)，之后每帧按深水色散关系 ω = √(g·|k|)
+// 解析地推进到时刻 t，再用一次批量的二维逆 FFT（FFTW，复数到实数）同时得到高度、水平位移和梯度五个场。
+// 每帧开销是 O(N² log N)，与水面有多少波浪无关；t 可以任意取，没有有限差分那样的稳定性限制。
+#pragma once
+#include <cstdint>
+#include <fftw3.h>
+#include "fftw_cache.h"
+
+class ThreadPool;
+
+enum class OceanSpectrum {
+    Phillips, // 充分成长的风浪，只有风速一个参数
+    Jonswap   // 有限风区（fetch）的风浪，谱峰更尖
+};
+
+struct OceanParams {
+    int size = 256;              // 每边采样数 N（偶数，2 的幂最快）
+    float patchLength = 256.0f;  // 一块海面的边长（米），采样间距 patchLength / size；海面按这个周期平铺
+    float windSpeed = 10.0f;     // 10 米高处的风速（米/秒）
+    float windDirection = 0.0f;  // 风向（弧度，0 为 +x）
+    OceanSpectrum spectrum = OceanSpectrum::Phillips;
+    float fetch = 100000.0f;     // JONSWAP 的风区长度（米）
+    float choppiness = 1.0f;     // 水平位移的倍数 λ，0 表示不要尖浪
+    uint32_t seed = 1;           // 初始频谱的随机数种子
+    unsigned planRigor = FFTW_MEASURE; // 逆变换计划的严格程度，wisdom 按尺寸缓存（fftw_cache.h）
+};
+
+class OceanFft {
+public:
+    // 生成初始频谱并制定逆变换计划（实测计划第一次可能要几百毫秒，之后从 wisdom 缓存读入）。
+    // 计划使用的线程数由之前的 fftwSetThreads() 决定
+    explicit OceanFft(const OceanParams& params);
+    ~OceanFft();
+    OceanFft(const OceanFft&) = delete;
+    OceanFft& operator=(const OceanFft&) = delete;
+
+    void setThreadPool(ThreadPool* threads) { pool = threads; } // 频谱推进按行并行，nullptr 表示单线程
+
+    // 推进到时刻 time（秒）并做一次批量逆 FFT，更新下面五个场
+    void synthesize(float time);
+
+    // 各场都是 size × size，行优先：(x, z) 处的值在 [z * size + x]，x 方向为 FFT 的最内维
+    int size() const { return n; }
+    const float* heights() const { return fields + size_t(0) * n * n; }       // 高度（米）
+    const float* displacementX() const { return fields + size_t(1) * n * n; } // 水平位移（米，已乘 λ）
+    const float* displacementZ() const { return fields + size_t(2) * n * n; }
+    const float* gradientX() const { return fields + size_t(3) * n * n; }     // ∂h/∂x（谱方法求导）
+    const float* gradientZ() const { return fields + size_t(4) * n * n; }
+
+    double spectrumMs() const { return lastSpectrumMs; } // 上一次 synthesize() 推进频谱的耗时
+    double fftMs() const { return lastFftMs; }           // 上一次批量逆 FFT 的耗时
+    const FftwPlanInfo& planInfo() const { return planning; }
+
+    static const int FIELD_COUNT = 5;
+
+private:
+    // 半平面上的一个波矢（FFTW 复数到实数的输入只存 kx >= 0 的一半）
+    struct Mode {
+        float h0Re, h0Im;   // h0(k)
+        float h0mRe, h0mIm; // conj(h0(-k))
+        float omega;        // 角频率
+        float kx, kz;
+        float invK;         // 1 / |k|，k = 0 时为 0
+    };
+
+    void fillSpectrumRows(int z0, int z1, float time);
+
+    int n;
+    int halfWidth;           // n / 2 + 1
+    float choppiness;
+    Mode* modes = nullptr;   // n × halfWidth
+    fftwf_complex* spectra = nullptr; // FIELD_COUNT 个 n × halfWidth 的频谱，依次排列
+    float* fields = nullptr;          // FIELD_COUNT 个 n × n 的实数场
+    fftwf_plan plan = nullptr;
+    ThreadPool* pool = nullptr;
+    double lastSpectrumMs = 0.0, lastFftMs = 0.0;
+    FftwPlanInfo planning;
+};
@@ -0,0 +1,59 @@
+﻿// radix_sort.cpp
+#include "radix_sort.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+void RadixSorter::sort(uint32_t* keys, uint32_t* values, size_t count, int keyBits, ThreadPool* pool) {
+    const int passes = (std::min(std::max(keyBits, 1), 32) + 7) / 8;
+    const int threadCount = pool ? pool->size() : 1;
+    keyScratch.resize(count);
+    valueScratch.resize(count);
+    histograms.resize(size_t(threadCount) * 256);
+
+    std::function<void(int, int)> task = [&](int thread, int threads) {
+        const size_t begin = count * thread / threads, end = count * (thread + 1) / threads;
+        size_t* hist = histograms.data() + size_t(thread) * 256;
+        uint32_t* srcKeys = keys;
+        uint32_t* srcValues = values;
+        uint32_t* dstKeys = keyScratch.data();
+        uint32_t* dstValues = valueScratch.data();
+        for (int pass = 0; pass < passes; ++pass) {
+            const int shift = pass * 8;
+            std::fill(hist, hist + 256, size_t(0));
+            for (size_t i = begin; i < end; ++i) hist[(srcKeys[i] >> shift) & 0xFF]++;
+            if (pool) pool->barrier();
+
+            // 桶优先、线程其次的前缀和：同一桶里线程 0 的元素排在前面，保证稳定
+            if (thread == 0) {
+                size_t offset = 0;
+                for (int digit = 0; digit < 256; ++digit) {
+                    for (int t = 0; t < threads; ++t) {
+                        size_t& slot = histograms[size_t(t) * 256 + digit];
+                        size_t n = slot;
+                        slot = offset;
+                        offset += n;
+                    }
+                }
+            }
+            if (pool) pool->barrier();
+
+            for (size_t i = begin; i < end; ++i) {
+                size_t at = hist[(srcKeys[i] >> shift) & 0xFF]++;
+                dstKeys[at] = srcKeys[i];
+                dstValues[at] = srcValues[i];
+            }
+            if (pool) pool->barrier(); // 下一趟要读全部输出
+            std::swap(srcKeys, dstKeys);
+            std::swap(srcValues, dstValues);
+        }
+        // 趟数为奇数时结果在暂存区，各线程拷回自己那一段
+        if (srcKeys != keys) {
+            std::memcpy(keys + begin, srcKeys + begin, sizeof(uint32_t) * (end - begin));
+            std::memcpy(values + begin, srcValues + begin, sizeof(uint32_t) * (end - begin));
+        }
+    };
+    if (pool) pool->run(task);
+    else task(0, 1);
+}
@@ -0,0 +1,20 @@
+﻿// radix_sort.h
+// 并行 LSD 基数排序：按 32 位键稳定排序 (键, 值) 对，每趟 8 位。每趟各线程先统计自己那一段的 256 桶直方图，
+// 同步后按 (桶, 线程) 的顺序求前缀和，再各自把自己那一段分散到输出里，结果与单线程完全一样。
+// 只排键的低 keyBits 位，趟数随之减少（例如 2×10 位的 Morton 码只要 3 趟）。
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+class RadixSorter {
+public:
+    // 按 keys 升序稳定排序，values 随键一起移动。keys 高于 keyBits 的位必须为 0；pool 为空时单线程
+    void sort(uint32_t* keys, uint32_t* values, size_t count, int keyBits, ThreadPool* pool);
+
+private:
+    std::vector<uint32_t> keyScratch, valueScratch;
+    std::vector<size_t> histograms; // 线程数 × 256，统计完后就地变成各线程各桶的写入位置
+};
@@ -0,0 +1,143 @@
+﻿// sim_config.cpp
+#include "sim_config.h"
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static bool parseInt(const std::string& text, int& value) {
+    char* end = nullptr;
+    errno = 0;
+    long v = std::strtol(text.c_str(), &end, 10);
+    if (text.empty() || *end != '\0') return false;
+    if (errno == ERANGE || v < INT_MIN || v > INT_MAX) return false; // long 是 64 位时（LP64）不能直接截断
+    value = static_cast<int>(v);
+    return true;
+}
+
+static bool parseFloat(const std::string& text, float& value) {
+    char* end = nullptr;
+    float v = std::strtof(text.c_str(), &end);
+    if (text.empty() || *end != '\0') return false;
+    value = v;
+    return true;
+}
+
+// "512x256" 或 "512"（正方形）
+static bool parseSize(const std::string& text, int& width, int& height) {
+    size_t x = text.find_first_of("xX");
+    if (x == std::string::npos) {
+        if (!parseInt(text, width)) return false;
+        height = width;
+        return true;
+    }
+    return parseInt(text.substr(0, x), width) && parseInt(text.substr(x + 1), height);
+}
+
+// 网格格子数上限：8192x8192。顶点 / 索引个数用 int 计数（6·W·H 不能超过 INT_MAX），
+// 再大的网格各个缓冲区加起来也要几 GB
+static const long long MAX_GRID_CELLS = 8192LL * 8192;
+
+static std::string trim(const std::string& s) {
+    size_t b = s.find_first_not_of(" \t\r");
+    if (b == std::string::npos) return "";
+    size_t e = s.find_last_not_of(" \t\r");
+    return s.substr(b, e - b + 1);
+}
+
+static bool applySetting(const std::string& key, const std::string& value, SimConfig& config) {
+    bool ok = true;
+    if (key == "width") ok = parseInt(value, config.width);
+    else if (key == "height") ok = parseInt(value, config.height);
+    else if (key == "size") ok = parseSize(value, config.width, config.height);
+    else if (key == "bench") ok = parseInt(value, config.benchSteps);
+    else if (key == "threads") ok = parseInt(value, config.threads);
+    else if (key == "temporal") ok = parseInt(value, config.temporal);
+    else if (key == "isa") config.isa = value;
+    else if (key == "specialize") ok = parseInt(value, config.specialize);
+    else if (key == "persistent") ok = parseInt(value, config.persistent);
+    else if (key == "render") config.render = value;
+    else if (key == "height_format") config.heightFormat = value;
+    else if (key == "index_order") config.indexOrder = value;
+    else if (key == "dirty_threshold") ok = parseFloat(value, config.dirtyThreshold);
+    else if (key == "sparse") ok = parseFloat(value, config.sparse);
+    else if (key == "sim_thread") ok = parseInt(value, config.simThread);
+    else if (key == "rain") ok = parseFloat(value, config.rain);
+    else if (key == "rain_seed") ok = parseInt(value, config.rainSeed);
+    else if (key == "picks") ok = parseInt(value, config.picks);
+    else if (key == "ocean") config.ocean = value;
+    else if (key == "wind") ok = parseFloat(value, config.wind);
+    else if (key == "fftw_plan") config.fftwPlan = value;
+    else if (key == "poisson") config.poisson = value;
+    else if (key == "particles") ok = parseInt(value, config.particles);
+    else if (key == "reorder") ok = parseInt(value, config.reorder);
+    else if (key == "config") return loadSimConfigFile(value, config);
+    else {
+        std::cerr << "Unknown setting '" << key << "'\n";
+        return false;
+    }
+    if (!ok) {
+        std::cerr << "Invalid value '" << value << "' for " << key << "\n";
+        return false;
+    }
+    if (config.width < 3 || config.height < 3) {
+        std::cerr << "Grid must be at least 3x3\n";
+        return false;
+    }
+    if ((long long)config.width * config.height > MAX_GRID_CELLS) {
+        std::cerr << "Grid must be at most " << MAX_GRID_CELLS << " cells (8192x8192)\n";
+        return false;
+    }
+    if (config.benchSteps < 0) {
+        std::cerr << "--bench needs a step count >= 0\n";
+        return false;
+    }
+    return true;
+}
+
+bool loadSimConfigFile(const std::string& path, SimConfig& config) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Cannot open config file " << path << "\n";
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) continue;
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) {
+            std::cerr << "Bad line in " << path << ": " << line << "\n";
+            return false;
+        }
+        if (!applySetting(trim(line.substr(0, eq)), trim(line.substr(eq + 1)), config)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool parseSimConfig(int argc, char** argv, SimConfig& config) {
+    for (int a = 1; a < argc; ++a) {
+        if (std::strncmp(argv[a], "--", 2) != 0) {
+            std::cerr << "Unexpected argument " << argv[a] << "\n";
+            return false;
+        }
+        std::string key = argv[a] + 2;
+        bool hasValue = a + 1 < argc && std::strncmp(argv[a + 1], "--", 2) != 0;
+        if (key == "bench" && !hasValue) {
+            config.benchSteps = 1000; // --bench 不带步数时默认 1000 步
+            continue;
+        }
+        if (!hasValue) {
+            std::cerr << "Missing value for --" << key << "\n";
+            return false;
+        }
+        if (!applySetting(key, argv[++a], config)) {
+            return false;
+        }
+    }
+    return true;
+}
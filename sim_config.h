@@ -0,0 +1,38 @@
+﻿// sim_config.h
+// 运行参数：网格分辨率、线程数等。先取默认值，再按命令行顺序覆盖；
+// --config 指定的文件（每行 key = value，# 开头为注释）在它出现的位置生效，后面的参数可以再覆盖它。
+#pragma once
+#include <string>
+
+struct SimConfig {
+    int width = 128;     // 网格宽度（格子数）
+    int height = 128;    // 网格高度
+    int benchSteps = 0;  // > 0 时进入无窗口基准测试
+    int threads = 1;     // 求解器线程数，0 表示全部硬件线程
+    int temporal = 1;    // 时间分块子步数，1 表示关闭
+    std::string isa;     // 模板内核指令集，空表示按 CPUID 自动选择
+    int specialize = 1;  // 常用分辨率走编译期特化的内核，0 表示全部走运行时版本
+    int persistent = 1;  // 顶点流式上传用持久映射环形缓冲区（需要 GL 4.4），0 表示强制用孤立方式
+    std::string render;  // 渲染方式（由各个演示程序解释），空表示默认方式
+    std::string heightFormat; // 高度上传格式（f32 / f16 / q16），空表示 f32
+    std::string indexOrder;   // 网格索引顺序（rows / stripes），空表示 stripes
+    float dirtyThreshold = 0.0f; // > 0 时只重新上传高度变化超过该值的分块，0 表示每帧整张上传
+    float sparse = 0.0f;         // > 0 时求解器只推进活跃分块，低于该值的平静分块休眠，0 表示关闭
+    int simThread = 1;           // 窗口模式下求解器在独立线程上按固定时间步推进，0 表示与渲染串行
+    float rain = 0.0f;           // 每秒随机落下的雨滴数，0 表示不下雨
+    int rainSeed = 1;            // 雨滴随机数种子
+    int picks = 0;               // --bench 时测试的拾取射线数
+    std::string ocean;           // 频谱海面的谱（phillips / jonswap），空表示用有限差分求解器
+    float wind = 10.0f;          // 频谱海面的风速（米/秒）
+    std::string fftwPlan;        // FFT 计划的严格程度（estimate / measure / patient），空表示 measure
+    std::string poisson;         // 线性方程组的解法（jacobi / fft，由各个演示程序解释），空表示 jacobi
+    int particles = 0;           // SPH 粒子数（SPH.cpp 解析前填入默认值，必须 >= 1）
+    int reorder = 0;             // SPH 每隔多少步按 Morton 序重排粒子，0 表示不重排
+};
+
+// 解析命令行参数（--width N --height N --size WxH --bench [N] --threads N --temporal K --isa NAME --specialize 0|1 --persistent 0|1 --render MODE --height_format FMT --index_order ORDER --dirty_threshold X --sparse EPS --sim_thread 0|1 --rain N --rain_seed N --picks N --ocean SPECTRUM --wind V --fftw_plan RIGOR --poisson SOLVER --particles N --reorder N --config FILE）。
+// 出错时向 std::cerr 打印原因并返回 false
+bool parseSimConfig(int argc, char** argv, SimConfig& config);
+
+// 读取配置文件，键名与命令行参数相同（不带 --）
+bool loadSimConfigFile(const std::string& path, SimConfig& config);
@@ -11,68 +11,207 @@
 //#include <vector>
 //#include <cmath>
 //#include <algorithm>
+//#include <cstring>
+//#include <fftw3.h>
 //
-//const int N = 64;              // Grid resolution (N x N)
+//#include "stencil_kernels.h"
+//#include "aligned_buffer.h"
+//#include "grid_dims.h"
+//#include "sim_config.h"
+//#include "fftw_cache.h"
+//
+//const int DEFAULT_N = 64;      // Default grid resolution (N x N), override with --size / --config
 //const float dt = 0.016f;       // Time step
 //const float visc = 0.0001f;    // Viscosity
 //const float diff = 0.0001f;    // Diffusion rate for density
-//const int solver_iter = 20;    // Jacobi iterations for pressure & diffusion
+//// Jacobi sweeps (--poisson jacobi). The original in-place Gauss-Seidel used 20 for
+//// both; Jacobi converges about half as fast per sweep, and needs ~50 to leave no more
+//// pressure residual than 20 Gauss-Seidel sweeps did (64..256). Diffusion is strongly
+//// diagonally dominant and is already converged after 20 either way.
+//const int diffuse_iter = 20;
+//const int pressure_iter = 50;
+//
+//// Grid resolution, chosen at startup. Each field holds (N + 2) rows of `stride`
+//// floats: a 1-cell ghost boundary on every side, rows padded to 64 bytes.
+//int N = DEFAULT_N;
+//int stride = 0;
+//#define IX(i, j) ((size_t)(i) * stride + (j))
 //
 //// Fluid fields
-//float u[N + 2][N + 2], v[N + 2][N + 2];        // Velocity (with 1-cell ghost boundary)
-//float u_prev[N + 2][N + 2], v_prev[N + 2][N + 2];
-//float dens[N + 2][N + 2], dens_prev[N + 2][N + 2];
-//float p[N + 2][N + 2];                     // Pressure
+//AlignedBuffer u, v;                        // Velocity
+//AlignedBuffer u_prev, v_prev;
+//AlignedBuffer dens, dens_prev;
+//AlignedBuffer p;                           // Pressure
+//AlignedBuffer jacobi_tmp;                  // Scratch iterate for lin_solve
+//
+//// Direct solver (--poisson fft). Every system lin_solve sees is the 5-point
+//// operator c*x - a*(sum of 4 neighbours) on the N x N interior, closed by the
+//// ghost cells set_bnd writes. A copied ghost (b == 0 side) is a Neumann wall half
+//// a cell out, diagonalized by DCT-II / DCT-III; a negated ghost (u across the
+//// i-walls, v across the j-walls) is a Dirichlet wall there, diagonalized by
+//// DST-II / DST-III. One forward/inverse plan pair per b, all in place on
+//// spectral_work.
+//bool spectral_solver = false;
+//float* spectral_work = nullptr;            // N x N interior, row-major
+//fftwf_plan spectral_forward[3] = {};
+//fftwf_plan spectral_inverse[3] = {};
+//std::vector<float> eig_neumann, eig_dirichlet; // 1D eigenvalues of (2x - left - right)
 //
 //GLuint shaderProgram;
 //GLuint quadVAO, quadVBO;
 //GLuint densityTexture;
 //
+//// --- Allocate all fields for an N x N grid (zero-filled) ---
+//void allocate_fields(int n) {
+//    N = n;
+//    stride = paddedStride(N + 2);
+//    size_t count = (size_t)(N + 2) * stride;
+//    AlignedBuffer* fields[] = { &u, &v, &u_prev, &v_prev, &dens, &dens_prev, &p, &jacobi_tmp };
+//    for (AlignedBuffer* f : fields) {
+//        f->allocate(count);
+//    }
+//}
+//
+//// --- Destroy the direct solver's plans (safe to call with some or none planned) ---
+//void destroy_spectral_plans() {
+//    for (int b = 0; b < 3; b++) {
+//        if (spectral_forward[b]) fftwf_destroy_plan(spectral_forward[b]);
+//        if (spectral_inverse[b]) fftwf_destroy_plan(spectral_inverse[b]);
+//        spectral_forward[b] = spectral_inverse[b] = nullptr;
+//    }
+//}
+//
+//// --- Plan the direct solver's transforms for the current N ---
+//// Must run after allocate_fields. Returns false if FFTW could not plan.
+//bool init_spectral_solver(unsigned rigor, FftwPlanInfo* info) {
+//    spectral_work = fftwf_alloc_real((size_t)N * N);
+//    eig_neumann.resize(N);
+//    eig_dirichlet.resize(N);
+//    const double pi = 3.14159265358979323846;
+//    for (int k = 0; k < N; k++) {
+//        eig_neumann[k] = (float)(2.0 - 2.0 * std::cos(pi * k / N));         // cos(pi k (i - 1/2) / N)
+//        eig_dirichlet[k] = (float)(2.0 - 2.0 * std::cos(pi * (k + 1) / N)); // sin(pi (k + 1) (i - 1/2) / N)
+//    }
+//
+//    // All six transforms share one wisdom file per size
+//    const std::string key = "r2r-" + std::to_string(N) + "x" + std::to_string(N);
+//    spectral_solver = fftwPlansCached(key, rigor, [](unsigned flags) {
+//        destroy_spectral_plans(); // leftovers from a failed wisdom-only attempt
+//        bool planned = true;
+//        for (int b = 0; b < 3; b++) {
+//            // The first transform dimension is i (rows), the second j
+//            fftwf_r2r_kind fwd_i = b == 1 ? FFTW_RODFT10 : FFTW_REDFT10;
+//            fftwf_r2r_kind fwd_j = b == 2 ? FFTW_RODFT10 : FFTW_REDFT10;
+//            fftwf_r2r_kind inv_i = b == 1 ? FFTW_RODFT01 : FFTW_REDFT01;
+//            fftwf_r2r_kind inv_j = b == 2 ? FFTW_RODFT01 : FFTW_REDFT01;
+//            spectral_forward[b] = fftwf_plan_r2r_2d(N, N, spectral_work, spectral_work, fwd_i, fwd_j, flags);
+//            spectral_inverse[b] = fftwf_plan_r2r_2d(N, N, spectral_work, spectral_work, inv_i, inv_j, flags);
+//            planned = planned && spectral_forward[b] && spectral_inverse[b];
+//        }
+//        if (!planned) destroy_spectral_plans();
+//        return planned;
+//    }, info);
+//    return spectral_solver;
+//}
+//
+//// --- Release the direct solver's plans and work buffer ---
+//void destroy_spectral_solver() {
+//    destroy_spectral_plans();
+//    fftwf_free(spectral_work);
+//    spectral_work = nullptr;
+//    spectral_solver = false;
+//}
+//
 //// --- Helper: Set boundary conditions ---
-//void set_bnd(int b, float x[N + 2][N + 2]) {
+//void set_bnd(int b, float* x) {
 //    for (int i = 1; i <= N; i++) {
-//        x[0][i] = b == 1 ? -x[1][i] : x[1][i];
-//        x[N + 1][i] = b == 1 ? -x[N][i] : x[N][i];
-//        x[i][0] = b == 2 ? -x[i][1] : x[i][1];
-//        x[i][N + 1] = b == 2 ? -x[i][N] : x[i][N];
+//        x[IX(0, i)] = b == 1 ? -x[IX(1, i)] : x[IX(1, i)];
+//        x[IX(N + 1, i)] = b == 1 ? -x[IX(N, i)] : x[IX(N, i)];
+//        x[IX(i, 0)] = b == 2 ? -x[IX(i, 1)] : x[IX(i, 1)];
+//        x[IX(i, N + 1)] = b == 2 ? -x[IX(i, N)] : x[IX(i, N)];
 //    }
-//    x[0][0] = 0.5f * (x[1][0] + x[0][1]);
-//    x[0][N + 1] = 0.5f * (x[1][N + 1] + x[0][N]);
-//    x[N + 1][0] = 0.5f * (x[N][0] + x[N + 1][1]);
-//    x[N + 1][N + 1] = 0.5f * (x[N][N + 1] + x[N + 1][N]);
+//    x[IX(0, 0)] = 0.5f * (x[IX(1, 0)] + x[IX(0, 1)]);
+//    x[IX(0, N + 1)] = 0.5f * (x[IX(1, N + 1)] + x[IX(0, N)]);
+//    x[IX(N + 1, 0)] = 0.5f * (x[IX(N, 0)] + x[IX(N + 1, 1)]);
+//    x[IX(N + 1, N + 1)] = 0.5f * (x[IX(N, N + 1)] + x[IX(N + 1, N)]);
 //}
 //
 //// --- Linear solver (Jacobi) for diffusion or pressure ---
-//void lin_solve(int b, float x[N + 2][N + 2], float x0[N + 2][N + 2], float a, float c) {
-//    for (int k = 0; k < solver_iter; k++) {
-//        for (int i = 1; i <= N; i++) {
-//            for (int j = 1; j <= N; j++) {
-//                x[i][j] = (x0[i][j] + a * (x[i - 1][j] + x[i + 1][j] + x[i][j - 1] + x[i][j + 1])) / c;
-//            }
+//// Each sweep reads only the previous iterate and writes the other buffer, so the
+//// whole grid goes through the shared SIMD stencil kernel (see stencil_kernels.h),
+//// which is specialized at compile time for the common power-of-two N.
+//void lin_solve(int b, float* x, float* x0, float a, float c, int iterations) {
+//    float* src = x;
+//    float* dst = jacobi_tmp.data();
+//    for (int k = 0; k < iterations; k++) {
+//        stencilJacobiGrid(dst, x0, src, N, a, c);
+//        set_bnd(b, dst);
+//        std::swap(src, dst);
+//    }
+//    if (src != x) {
+//        std::memcpy(x, src, sizeof(float) * (N + 2) * stride);
+//    }
+//}
+//
+//// --- Direct solver for the same system as lin_solve ---
+//// Transform x0, divide by the operator's eigenvalue c - 4a + a*(lambda_i + lambda_j),
+//// transform back: the exact solution in O(N^2 log N) instead of Jacobi sweeps.
+//// For the pressure equation (a = 1, c = 4, Neumann on all sides) the constant mode
+//// has eigenvalue 0; it is set to zero, which fixes the free pressure offset (the
+//// divergence from project() already sums to zero, so nothing else is lost).
+//void spectral_solve(int b, float* x, const float* x0, float a, float c) {
+//    float* w = spectral_work;
+//    for (int i = 1; i <= N; i++) {
+//        std::memcpy(w + (size_t)(i - 1) * N, x0 + IX(i, 1), sizeof(float) * N);
+//    }
+//    fftwf_execute(spectral_forward[b]);
+//
+//    // Each DCT/DST pair scales by 2N per dimension
+//    const float* eig_i = b == 1 ? eig_dirichlet.data() : eig_neumann.data();
+//    const float* eig_j = b == 2 ? eig_dirichlet.data() : eig_neumann.data();
+//    const float norm = 1.0f / (4.0f * N * N);
+//    const float diag = c - 4 * a;
+//    for (int k = 0; k < N; k++) {
+//        float* row = w + (size_t)k * N;
+//        for (int l = 0; l < N; l++) {
+//            float eig = diag + a * (eig_i[k] + eig_j[l]);
+//            row[l] = eig > 0 ? row[l] * norm / eig : 0.0f;
 //        }
-//        set_bnd(b, x);
 //    }
+//
+//    fftwf_execute(spectral_inverse[b]);
+//    for (int i = 1; i <= N; i++) {
+//        std::memcpy(x + IX(i, 1), w + (size_t)(i - 1) * N, sizeof(float) * N);
+//    }
+//    set_bnd(b, x);
 //}
 //
 //// --- Diffuse velocity or density ---
-//void diffuse(int b, float x[N + 2][N + 2], float x0[N + 2][N + 2], float diff) {
+//void diffuse(int b, float* x, float* x0, float diff) {
 //    float a = dt * diff * N * N;
-//    lin_solve(b, x, x0, a, 1 + 4 * a);
+//    if (spectral_solver) spectral_solve(b, x, x0, a, 1 + 4 * a);
+//    else lin_solve(b, x, x0, a, 1 + 4 * a, diffuse_iter);
 //}
 //
 //// --- Advect using Semi-Lagrangian backtrace ---
-//void advect(int b, float d[N + 2][N + 2], float d0[N + 2][N + 2], float u[N + 2][N + 2], float v[N + 2][N + 2]) {
-//    float dt0 = dt * N;
-//    for (int i = 1; i <= N; i++) {
-//        for (int j = 1; j <= N; j++) {
-//            float x = i - dt0 * u[i][j];
-//            float y = j - dt0 * v[i][j];
+//// Templated on the grid dimensions (grid_dims.h): for the common power-of-two N
+//// the resolution and row stride are compile-time constants, so the clamps and
+//// the four-tap address arithmetic fold to immediates.
+//template <class Dims>
+//void advect_grid(Dims dims, float* d, const float* d0, const float* u, const float* v) {
+//    const int n = dims.width() - 2;
+//    const int s = dims.stride();
+//    float dt0 = dt * n;
+//    for (int i = 1; i <= n; i++) {
+//        for (int j = 1; j <= n; j++) {
+//            float x = i - dt0 * u[(size_t)i * s + j];
+//            float y = j - dt0 * v[(size_t)i * s + j];
 //
 //            // Clamp to [0.5, N+0.5]
 //            if (x < 0.5f) x = 0.5f;
-//            if (x > N + 0.5f) x = N + 0.5f;
+//            if (x > n + 0.5f) x = n + 0.5f;
 //            if (y < 0.5f) y = 0.5f;
-//            if (y > N + 0.5f) y = N + 0.5f;
+//            if (y > n + 0.5f) y = n + 0.5f;
 //
 //            int i0 = (int)x, i1 = i0 + 1;
 //            int j0 = (int)y, j1 = j0 + 1;
@@ -80,32 +219,37 @@
 //            float s1 = x - i0, s0 = 1.0f - s1;
 //            float t1 = y - j0, t0 = 1.0f - t1;
 //
-//            d[i][j] = s0 * (t0 * d0[i0][j0] + t1 * d0[i0][j1]) +
-//                s1 * (t0 * d0[i1][j0] + t1 * d0[i1][j1]);
+//            d[(size_t)i * s + j] = s0 * (t0 * d0[(size_t)i0 * s + j0] + t1 * d0[(size_t)i0 * s + j1]) +
+//                s1 * (t0 * d0[(size_t)i1 * s + j0] + t1 * d0[(size_t)i1 * s + j1]);
 //        }
 //    }
+//}
+//
+//void advect(int b, float* d, float* d0, float* u, float* v) {
+//    withGridDims<1>(N, N, [&](auto dims) { advect_grid(dims, d, d0, u, v); });
 //    set_bnd(b, d);
 //}
 //
 //// --- Project velocity to divergence-free field ---
-//void project(float u[N + 2][N + 2], float v[N + 2][N + 2], float p[N + 2][N + 2], float div[N + 2][N + 2]) {
+//void project(float* u, float* v, float* p, float* div) {
 //    // Compute divergence
 //    for (int i = 1; i <= N; i++) {
 //        for (int j = 1; j <= N; j++) {
-//            div[i][j] = -0.5f * (u[i + 1][j] - u[i - 1][j] + v[i][j + 1] - v[i][j - 1]) / N;
-//            p[i][j] = 0;
+//            div[IX(i, j)] = -0.5f * (u[IX(i + 1, j)] - u[IX(i - 1, j)] + v[IX(i, j + 1)] - v[IX(i, j - 1)]) / N;
+//            p[IX(i, j)] = 0;
 //        }
 //    }
 //    set_bnd(0, div); set_bnd(0, p);
 //
 //    // Solve Poisson equation: ∇²p = div
-//    lin_solve(0, p, div, 1, 4);
+//    if (spectral_solver) spectral_solve(0, p, div, 1, 4);
+//    else lin_solve(0, p, div, 1, 4, pressure_iter);
 //
 //    // Subtract gradient of pressure
 //    for (int i = 1; i <= N; i++) {
 //        for (int j = 1; j <= N; j++) {
-//            u[i][j] -= 0.5f * (p[i + 1][j] - p[i - 1][j]) * N;
-//            v[i][j] -= 0.5f * (p[i][j + 1] - p[i][j - 1]) * N;
+//            u[IX(i, j)] -= 0.5f * (p[IX(i + 1, j)] - p[IX(i - 1, j)]) * N;
+//            v[IX(i, j)] -= 0.5f * (p[IX(i, j + 1)] - p[IX(i, j - 1)]) * N;
 //        }
 //    }
 //    set_bnd(1, u); set_bnd(2, v);
@@ -114,23 +258,23 @@
 //// --- Main fluid step ---
 //void fluid_step() {
 //    // --- Velocity Step ---
-//    diffuse(1, u_prev, u, visc);
-//    diffuse(2, v_prev, v, visc);
-//    advect(1, u, u_prev, u_prev, v_prev);
-//    advect(2, v, v_prev, u_prev, v_prev);
-//    project(u, v, p, u_prev); // reuse u_prev as div buffer
+//    diffuse(1, u_prev.data(), u.data(), visc);
+//    diffuse(2, v_prev.data(), v.data(), visc);
+//    advect(1, u.data(), u_prev.data(), u_prev.data(), v_prev.data());
+//    advect(2, v.data(), v_prev.data(), u_prev.data(), v_prev.data());
+//    project(u.data(), v.data(), p.data(), u_prev.data()); // reuse u_prev as div buffer
 //
 //    // --- Density Step ---
-//    diffuse(0, dens_prev, dens, diff);
-//    advect(0, dens, dens_prev, u, v);
+//    diffuse(0, dens_prev.data(), dens.data(), diff);
+//    advect(0, dens.data(), dens_prev.data(), u.data(), v.data());
 //}
 //
 //// --- Add density and velocity at mouse position ---
 //void add_source(int x, int y, float amount = 100.0f) {
 //    if (x < 1 || x > N || y < 1 || y > N) return;
-//    dens[x][y] += amount;
-//    u[x][y] += (rand() % 1000) / 500.0f - 1.0f; // random x impulse
-//    v[x][y] += 2.0f;                             // upward impulse
+//    dens.data()[IX(x, y)] += amount;
+//    u.data()[IX(x, y)] += (rand() % 1000) / 500.0f - 1.0f; // random x impulse
+//    v.data()[IX(x, y)] += 2.0f;                             // upward impulse
 //}
 //
 //// --- OpenGL: Fullscreen quad shader ---
@@ -216,10 +360,10 @@
 //
 //void render() {
 //    // Upload density to GPU
-//    std::vector<float> texData(N * N);
+//    std::vector<float> texData((size_t)N * N);
 //    for (int i = 0; i < N; i++) {
 //        for (int j = 0; j < N; j++) {
-//            texData[i * N + j] = clamp(dens[i + 1][j + 1], 0.0f, 1.0f);
+//            texData[i * N + j] = clamp(dens.data()[IX(i + 1, j + 1)], 0.0f, 1.0f);
 //        }
 //    }
 //    glBindTexture(GL_TEXTURE_2D, densityTexture);
@@ -250,7 +394,42 @@
 //
 //
 //// Main
-//int main() {
+//int main(int argc, char** argv) {
+//    stencilFlushDenormals(); // decaying density/velocity would otherwise hit denormal slow paths
+//
+//    // The solver is square: --size N (or width in a config file) sets the resolution
+//    SimConfig config;
+//    config.width = config.height = DEFAULT_N;
+//    if (!parseSimConfig(argc, argv, config)) return -1;
+//    if (config.width != config.height) {
+//        std::cerr << "stable_fluids needs a square grid, got " << config.width << "x" << config.height << "\n";
+//        return -1;
+//    }
+//    allocate_fields(config.width); // fields start zeroed
+//
+//    // --poisson fft: solve pressure and diffusion directly with FFTW instead of Jacobi
+//    if (config.poisson == "fft") {
+//        unsigned rigor = FFTW_MEASURE;
+//        if (!config.fftwPlan.empty() && !parseFftwRigor(config.fftwPlan, rigor)) {
+//            std::cerr << "Unknown --fftw_plan " << config.fftwPlan << "\n";
+//            return -1;
+//        }
+//        fftwSetThreads(config.threads);
+//        FftwPlanInfo plan;
+//        if (!init_spectral_solver(rigor, &plan)) {
+//            destroy_spectral_solver();
+//            std::cerr << "FFTW could not plan the " << N << "x" << N << " DCT/DST transforms\n";
+//            return -1;
+//        }
+//        std::cout << "[fftw] " << fftwThreads() << " threads, 6 DCT/DST plans " << plan.planMs << " ms"
+//                  << (plan.path.empty() ? std::string(" (estimate, no cache)")
+//                      : (plan.fromCache ? " from wisdom cache" : " measured and cached")) << "\n";
+//    }
+//    else if (!config.poisson.empty() && config.poisson != "jacobi") {
+//        std::cerr << "Unknown --poisson " << config.poisson << " (jacobi or fft)\n";
+//        return -1;
+//    }
+//
 //    glfwInit();
 //    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 //    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -272,11 +451,6 @@
 //    shaderProgram = createShaderProgram();
 //    initRender();
 //
-//    // Initialize fields to zero
-//    for (int i = 0; i < N + 2; i++)
-//        for (int j = 0; j < N + 2; j++)
-//            u[i][j] = v[i][j] = dens[i][j] = p[i][j] = 0.0f;
-//
 //    while (!glfwWindowShouldClose(window)) {
 //        // Add source at mouse
 //        if (mouseX >= 0 && mouseY >= 0) {
@@ -293,6 +467,7 @@
 //        glfwPollEvents();
 //    }
 //
+//    destroy_spectral_solver();
 //    glfwTerminate();
 //    return 0;
 //}
\ No newline at end of file
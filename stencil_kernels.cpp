@@ -0,0 +1,367 @@
+﻿// stencil_kernels.cpp
+#include "stencil_kernels.h"
+#include "grid_dims.h"
+#include <cstring>
+
+// 关闭乘加融合：否则编译器可能把 mul + add 合成 FMA，SIMD 版与标量版就不再逐位一致
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define STENCIL_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// MSVC 不需要额外开关就能使用内建函数；GCC/Clang 需要按函数打开对应指令集
+#if defined(_MSC_VER) && !defined(__clang__)
+#define STENCIL_TARGET(isa)
+#else
+#define STENCIL_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+// 下面的内核都以 Dims（grid_dims.h）为模板参数，一次处理 rows 行：指针指向第一行第一个要更新的格子，
+// 每行更新 width() - 2 个格子，行与行相隔 stride()。常用分辨率下两者都是编译期常量
+
+// --- 标量版（参考实现）---
+template <class Dims>
+static void waveRowsScalar(float* out, const float* c, const float* p, Dims dims, int rows,
+                           float courant2, float damping) {
+    const int stride = dims.stride(), count = dims.width() - 2;
+    for (int r = 0; r < rows; ++r, out += stride, c += stride, p += stride) {
+        for (int i = 0; i < count; ++i) {
+            float lap = c[i - stride] + c[i + stride] + c[i - 1] + c[i + 1] - 4.0f * c[i];
+            out[i] = (2.0f * c[i] - p[i] + courant2 * lap) * damping;
+        }
+    }
+}
+
+template <class Dims>
+static void jacobiRowsScalar(float* out, const float* x0, const float* x, Dims dims, int rows,
+                             float a, float c) {
+    const int stride = dims.stride(), count = dims.width() - 2;
+    for (int r = 0; r < rows; ++r, out += stride, x0 += stride, x += stride) {
+        for (int i = 0; i < count; ++i) {
+            out[i] = (x0[i] + a * (x[i - stride] + x[i + stride] + x[i - 1] + x[i + 1])) / c;
+        }
+    }
+}
+
+#ifdef STENCIL_X86
+// --- SSE4.2：每次 4 个格子 ---
+template <class Dims>
+STENCIL_TARGET("sse4.2")
+static void waveRowsSSE42(float* out, const float* c, const float* p, Dims dims, int rows,
+                          float courant2, float damping) {
+    const int stride = dims.stride(), count = dims.width() - 2;
+    const __m128 two = _mm_set1_ps(2.0f), four = _mm_set1_ps(4.0f);
+    const __m128 k = _mm_set1_ps(courant2), d = _mm_set1_ps(damping);
+    for (int r = 0; r < rows; ++r, out += stride, c += stride, p += stride) {
+        int i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128 center = _mm_loadu_ps(c + i);
+            __m128 lap = _mm_add_ps(_mm_loadu_ps(c + i - stride), _mm_loadu_ps(c + i + stride));
+            lap = _mm_add_ps(lap, _mm_loadu_ps(c + i - 1));
+            lap = _mm_add_ps(lap, _mm_loadu_ps(c + i + 1));
+            lap = _mm_sub_ps(lap, _mm_mul_ps(four, center));
+            __m128 h = _mm_sub_ps(_mm_mul_ps(two, center), _mm_loadu_ps(p + i));
+            h = _mm_add_ps(h, _mm_mul_ps(k, lap));
+            _mm_storeu_ps(out + i, _mm_mul_ps(h, d));
+        }
+        for (; i < count; ++i) { // 尾部逐个处理（留在本函数内，避免 AVX/SSE 切换开销）
+            float lap = c[i - stride] + c[i + stride] + c[i - 1] + c[i + 1] - 4.0f * c[i];
+            out[i] = (2.0f * c[i] - p[i] + courant2 * lap) * damping;
+        }
+    }
+}
+
+template <class Dims>
+STENCIL_TARGET("sse4.2")
+static void jacobiRowsSSE42(float* out, const float* x0, const float* x, Dims dims, int rows,
+                            float a, float c) {
+    const int stride = dims.stride(), count = dims.width() - 2;
+    const __m128 va = _mm_set1_ps(a), vc = _mm_set1_ps(c);
+    for (int r = 0; r < rows; ++r, out += stride, x0 += stride, x += stride) {
+        int i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128 sum = _mm_add_ps(_mm_loadu_ps(x + i - stride), _mm_loadu_ps(x + i + stride));
+            sum = _mm_add_ps(sum, _mm_loadu_ps(x + i - 1));
+            sum = _mm_add_ps(sum, _mm_loadu_ps(x + i + 1));
+            __m128 res = _mm_add_ps(_mm_loadu_ps(x0 + i), _mm_mul_ps(va, sum));
+            _mm_storeu_ps(out + i, _mm_div_ps(res, vc));
+        }
+        for (; i < count; ++i) {
+            out[i] = (x0[i] + a * (x[i - stride] + x[i + stride] + x[i - 1] + x[i + 1])) / c;
+        }
+    }
+}
+
+// --- AVX2：每次 8 个格子 ---
+template <class Dims>
+STENCIL_TARGET("avx2")
+static void waveRowsAVX2(float* out, const float* c, const float* p, Dims dims, int rows,
+                         float courant2, float damping) {
+    const int stride = dims.stride(), count = dims.width() - 2;
+    const __m256 two = _mm256_set1_ps(2.0f), four = _mm256_set1_ps(4.0f);
+    const __m256 k = _mm256_set1_ps(courant2), d = _mm256_set1_ps(damping);
+    for (int r = 0; r < rows; ++r, out += stride, c += stride, p += stride) {
+        int i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256 center = _mm256_loadu_ps(c + i);
+            __m256 lap = _mm256_add_ps(_mm256_loadu_ps(c + i - stride), _mm256_loadu_ps(c + i + stride));
+            lap = _mm256_add_ps(lap, _mm256_loadu_ps(c + i - 1));
+            lap = _mm256_add_ps(lap, _mm256_loadu_ps(c + i + 1));
+            lap = _mm256_sub_ps(lap, _mm256_mul_ps(four, center));
+            __m256 h = _mm256_sub_ps(_mm256_mul_ps(two, center), _mm256_loadu_ps(p + i));
+            h = _mm256_add_ps(h, _mm256_mul_ps(k, lap));
+            _mm256_storeu_ps(out + i, _mm256_mul_ps(h, d));
+        }
+        for (; i < count; ++i) { // 尾部逐个处理（留在本函数内，避免 AVX/SSE 切换开销）
+            float lap = c[i - stride] + c[i + stride] + c[i - 1] + c[i + 1] - 4.0f * c[i];
+            out[i] = (2.0f * c[i] - p[i] + courant2 * lap) * damping;
+        }
+    }
+}
+
+template <class Dims>
+STENCIL_TARGET("avx2")
+static void jacobiRowsAVX2(float* out, const float* x0, const float* x, Dims dims, int rows,
+                           float a, float c) {
+    const int stride = dims.stride(), count = dims.width() - 2;
+    const __m256 va = _mm256_set1_ps(a), vc = _mm256_set1_ps(c);
+    for (int r = 0; r < rows; ++r, out += stride, x0 += stride, x += stride) {
+        int i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256 sum = _mm256_add_ps(_mm256_loadu_ps(x + i - stride), _mm256_loadu_ps(x + i + stride));
+            sum = _mm256_add_ps(sum, _mm256_loadu_ps(x + i - 1));
+            sum = _mm256_add_ps(sum, _mm256_loadu_ps(x + i + 1));
+            __m256 res = _mm256_add_ps(_mm256_loadu_ps(x0 + i), _mm256_mul_ps(va, sum));
+            _mm256_storeu_ps(out + i, _mm256_div_ps(res, vc));
+        }
+        for (; i < count; ++i) {
+            out[i] = (x0[i] + a * (x[i - stride] + x[i + stride] + x[i - 1] + x[i + 1])) / c;
+        }
+    }
+}
+
+// --- AVX-512：每次 16 个格子，尾部用掩码处理 ---
+template <class Dims>
+STENCIL_TARGET("avx512f")
+static void waveRowsAVX512(float* out, const float* c, const float* p, Dims dims, int rows,
+                           float courant2, float damping) {
+    const int stride = dims.stride(), count = dims.width() - 2;
+    const __m512 two = _mm512_set1_ps(2.0f), four = _mm512_set1_ps(4.0f);
+    const __m512 k = _mm512_set1_ps(courant2), d = _mm512_set1_ps(damping);
+    for (int r = 0; r < rows; ++r, out += stride, c += stride, p += stride) {
+        for (int i = 0; i < count; i += 16) {
+            __mmask16 m = count - i >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << (count - i)) - 1u);
+            __m512 center = _mm512_maskz_loadu_ps(m, c + i);
+            __m512 lap = _mm512_add_ps(_mm512_maskz_loadu_ps(m, c + i - stride), _mm512_maskz_loadu_ps(m, c + i + stride));
+            lap = _mm512_add_ps(lap, _mm512_maskz_loadu_ps(m, c + i - 1));
+            lap = _mm512_add_ps(lap, _mm512_maskz_loadu_ps(m, c + i + 1));
+            lap = _mm512_sub_ps(lap, _mm512_mul_ps(four, center));
+            __m512 h = _mm512_sub_ps(_mm512_mul_ps(two, center), _mm512_maskz_loadu_ps(m, p + i));
+            h = _mm512_add_ps(h, _mm512_mul_ps(k, lap));
+            _mm512_mask_storeu_ps(out + i, m, _mm512_mul_ps(h, d));
+        }
+    }
+}
+
+template <class Dims>
+STENCIL_TARGET("avx512f")
+static void jacobiRowsAVX512(float* out, const float* x0, const float* x, Dims dims, int rows,
+                             float a, float c) {
+    const int stride = dims.stride(), count = dims.width() - 2;
+    const __m512 va = _mm512_set1_ps(a), vc = _mm512_set1_ps(c);
+    for (int r = 0; r < rows; ++r, out += stride, x0 += stride, x += stride) {
+        for (int i = 0; i < count; i += 16) {
+            __mmask16 m = count - i >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << (count - i)) - 1u);
+            __m512 sum = _mm512_add_ps(_mm512_maskz_loadu_ps(m, x + i - stride), _mm512_maskz_loadu_ps(m, x + i + stride));
+            sum = _mm512_add_ps(sum, _mm512_maskz_loadu_ps(m, x + i - 1));
+            sum = _mm512_add_ps(sum, _mm512_maskz_loadu_ps(m, x + i + 1));
+            __m512 res = _mm512_add_ps(_mm512_maskz_loadu_ps(m, x0 + i), _mm512_mul_ps(va, sum));
+            _mm512_mask_storeu_ps(out + i, m, _mm512_div_ps(res, vc));
+        }
+    }
+}
+
+// --- CPUID 检测 ---
+static void cpuid(int regs[4], int leaf, int subleaf) {
+#if defined(_MSC_VER)
+    __cpuidex(regs, leaf, subleaf);
+#else
+    unsigned a, b, c, d;
+    __cpuid_count(leaf, subleaf, a, b, c, d);
+    regs[0] = int(a); regs[1] = int(b); regs[2] = int(c); regs[3] = int(d);
+#endif
+}
+
+// XCR0：操作系统是否在上下文切换时保存 YMM/ZMM 寄存器
+static unsigned long long readXcr0() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return (static_cast<unsigned long long>(hi) << 32) | lo;
+#endif
+}
+#endif // STENCIL_X86
+
+StencilIsa detectStencilIsa() {
+#ifdef STENCIL_X86
+    int regs[4];
+    cpuid(regs, 0, 0);
+    int maxLeaf = regs[0];
+    cpuid(regs, 1, 0);
+    bool sse42 = (regs[2] & (1 << 20)) != 0;
+    bool osxsave = (regs[2] & (1 << 27)) != 0;
+    bool avx = (regs[2] & (1 << 28)) != 0;
+    if (!sse42) return StencilIsa::Scalar;
+    if (!osxsave || !avx || maxLeaf < 7) return StencilIsa::SSE42;
+
+    unsigned long long xcr0 = readXcr0();
+    if ((xcr0 & 0x6) != 0x6) return StencilIsa::SSE42;
+    cpuid(regs, 7, 0);
+    bool avx2 = (regs[1] & (1 << 5)) != 0;
+    bool avx512f = (regs[1] & (1 << 16)) != 0;
+    if (avx512f && (xcr0 & 0xE0) == 0xE0) return StencilIsa::AVX512;
+    return avx2 ? StencilIsa::AVX2 : StencilIsa::SSE42;
+#else
+    return StencilIsa::Scalar;
+#endif
+}
+
+// --- 分发 ---
+// 按当前指令集选内核；Dims 不同的实例各自有一份四个指令集的版本
+template <class Dims>
+static void waveRows(StencilIsa isa, float* out, const float* c, const float* p, Dims dims, int rows,
+                     float courant2, float damping) {
+    switch (isa) {
+#ifdef STENCIL_X86
+    case StencilIsa::AVX512: waveRowsAVX512(out, c, p, dims, rows, courant2, damping); return;
+    case StencilIsa::AVX2:   waveRowsAVX2(out, c, p, dims, rows, courant2, damping); return;
+    case StencilIsa::SSE42:  waveRowsSSE42(out, c, p, dims, rows, courant2, damping); return;
+#endif
+    default:                 waveRowsScalar(out, c, p, dims, rows, courant2, damping); return;
+    }
+}
+
+template <class Dims>
+static void jacobiRows(StencilIsa isa, float* out, const float* x0, const float* x, Dims dims, int rows,
+                       float a, float c) {
+    switch (isa) {
+#ifdef STENCIL_X86
+    case StencilIsa::AVX512: jacobiRowsAVX512(out, x0, x, dims, rows, a, c); return;
+    case StencilIsa::AVX2:   jacobiRowsAVX2(out, x0, x, dims, rows, a, c); return;
+    case StencilIsa::SSE42:  jacobiRowsSSE42(out, x0, x, dims, rows, a, c); return;
+#endif
+    default:                 jacobiRowsScalar(out, x0, x, dims, rows, a, c); return;
+    }
+}
+
+struct StencilState {
+    StencilIsa isa;
+    bool specialized;
+};
+
+// 第一次使用时检测一次，之后不再执行 CPUID
+static StencilState& activeState() {
+    static StencilState state = { detectStencilIsa(), true };
+    return state;
+}
+
+StencilIsa stencilIsa() {
+    return activeState().isa;
+}
+
+void setStencilIsa(StencilIsa isa) {
+    StencilIsa best = detectStencilIsa();
+    activeState().isa = static_cast<int>(isa) <= static_cast<int>(best) ? isa : best;
+}
+
+bool stencilSpecialized() {
+    return activeState().specialized;
+}
+
+void setStencilSpecialized(bool enabled) {
+    activeState().specialized = enabled;
+}
+
+const char* stencilIsaName(StencilIsa isa) {
+    switch (isa) {
+    case StencilIsa::SSE42:  return "sse4.2";
+    case StencilIsa::AVX2:   return "avx2";
+    case StencilIsa::AVX512: return "avx512";
+    default:                 return "scalar";
+    }
+}
+
+bool parseStencilIsa(const char* name, StencilIsa& isa) {
+    const StencilIsa all[] = { StencilIsa::Scalar, StencilIsa::SSE42, StencilIsa::AVX2, StencilIsa::AVX512 };
+    for (StencilIsa candidate : all) {
+        if (std::strcmp(name, stencilIsaName(candidate)) == 0) {
+            isa = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+void stencilFlushDenormals() {
+#ifdef STENCIL_X86
+    _mm_setcsr(_mm_getcsr() | 0x8040); // FTZ (bit 15) | DAZ (bit 6)
+#endif
+}
+
+// 单行接口：把这一行看成宽 count + 2、行跨度 stride 的网格，走运行时尺寸版本
+void stencilWaveRow(float* out, const float* c, const float* p,
+                    int stride, int count, float courant2, float damping) {
+    waveRows(activeState().isa, out, c, p, RuntimeGridDims(count + 2, 3, stride), 1, courant2, damping);
+}
+
+void stencilWaveRect(float* out, const float* c, const float* p,
+                     int stride, int count, int rows, float courant2, float damping) {
+    waveRows(activeState().isa, out, c, p, RuntimeGridDims(count + 2, rows + 2, stride), rows, courant2, damping);
+}
+
+void stencilJacobiRow(float* out, const float* x0, const float* x,
+                      int stride, int count, float a, float c) {
+    jacobiRows(activeState().isa, out, x0, x, RuntimeGridDims(count + 2, 3, stride), 1, a, c);
+}
+
+void stencilWaveRows(float* out, const float* c, const float* p, int width, int height,
+                     int j0, int j1, float courant2, float damping) {
+    const StencilState& state = activeState();
+    auto run = [&](auto dims) {
+        size_t first = size_t(j0) * dims.stride() + 1;
+        waveRows(state.isa, out + first, c + first, p + first, dims, j1 - j0, courant2, damping);
+    };
+    if (state.specialized) {
+        withGridDims(width, height, run);
+    }
+    else {
+        run(RuntimeGridDims(width, height));
+    }
+}
+
+void stencilJacobiGrid(float* out, const float* x0, const float* x, int n, float a, float c) {
+    const StencilState& state = activeState();
+    auto run = [&](auto dims) {
+        size_t first = size_t(dims.stride()) + 1;
+        jacobiRows(state.isa, out + first, x0 + first, x + first, dims, dims.height() - 2, a, c);
+    };
+    if (state.specialized) {
+        withGridDims<1>(n, n, run);
+    }
+    else {
+        run(RuntimeGridDims(n + 2, n + 2));
+    }
+}
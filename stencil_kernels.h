@@ -0,0 +1,49 @@
+﻿// stencil_kernels.h
+// 5 点拉普拉斯模板的行内核：标量 / SSE4.2 / AVX2 / AVX-512 四个版本，
+// 启动时用 CPUID 选一次，之后所有调用都走选中的版本。
+// 各版本的加法、乘法顺序与标量版完全相同（不使用 FMA），结果逐位一致。
+#pragma once
+
+enum class StencilIsa {
+    Scalar,
+    SSE42,
+    AVX2,
+    AVX512
+};
+
+StencilIsa detectStencilIsa();           // CPU 和操作系统同时支持的最高指令集
+StencilIsa stencilIsa();                 // 当前使用的指令集
+void setStencilIsa(StencilIsa isa);      // 强制指定（不超过 detectStencilIsa()），例如切回标量做逐位比对
+const char* stencilIsaName(StencilIsa isa);
+bool parseStencilIsa(const char* name, StencilIsa& isa); // "scalar" / "sse4.2" / "avx2" / "avx512"
+
+// 整网格接口在常用分辨率（grid_dims.h 的 GRID_FIXED_SIZES）下走编译期特化的内核，默认开启。
+// 关闭后所有尺寸都走运行时版本，用于对比速度和校验和
+bool stencilSpecialized();
+void setStencilSpecialized(bool enabled);
+
+// 当前线程打开 FTZ/DAZ。阻尼让波高衰减进入非规格化数范围，不打开时每个格子都会触发微码辅助，
+// 模板计算会慢数倍。只影响当前线程，工作线程需要各自调用。
+void stencilFlushDenormals();
+
+// 波动方程一行：out[i] = (2c[i] - p[i] + courant2 * lap(c)[i]) * damping，i ∈ [0, count)
+// c 指向行内第一个要更新的格子，stride 为行跨度（c[i ± stride] 是上下邻居）
+void stencilWaveRow(float* out, const float* c, const float* p,
+                    int stride, int count, float courant2, float damping);
+
+// 波动方程一块矩形：从 c 指向的格子开始 rows 行、每行 count 个，一次分派（稀疏求解的分块用）
+void stencilWaveRect(float* out, const float* c, const float* p,
+                     int stride, int count, int rows, float courant2, float damping);
+
+// Jacobi 迭代一行：out[i] = (x0[i] + a * (x 的四邻居之和)) / c
+void stencilJacobiRow(float* out, const float* x0, const float* x,
+                      int stride, int count, float a, float c);
+
+// 整网格接口：宽、高决定行跨度 paddedStride(width)，尺寸在常用列表里时走编译期特化版本
+
+// 波动方程更新行 [j0, j1) 的第 1 … width-2 列，指针指向网格第 0 行第 0 列
+void stencilWaveRows(float* out, const float* c, const float* p, int width, int height,
+                     int j0, int j1, float courant2, float damping);
+
+// Stam 风格网格（N×N 内部格子加一圈边界，行跨度 paddedStride(N + 2)）：对全部内部格子做一次 Jacobi 迭代
+void stencilJacobiGrid(float* out, const float* x0, const float* x, int n, float a, float c);
@@ -0,0 +1,84 @@
+﻿// stream_buffer.cpp
+#include "stream_buffer.h"
+
+void StreamBuffer::create(GLenum bufferTarget, size_t bytes, bool allowPersistent) {
+    destroy();
+    target = bufferTarget;
+    slotBytes = bytes;
+    glGenBuffers(1, &id);
+    glBindBuffer(target, id);
+
+    // glBufferStorage 是 4.4 核心函数；窗口按 3.3 创建时多数驱动仍会给出更高版本的上下文
+    if (allowPersistent && GLAD_GL_VERSION_4_4) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(target, GLsizeiptr(slotBytes * SLOTS), nullptr, flags);
+        mapped = static_cast<unsigned char*>(glMapBufferRange(target, 0, GLsizeiptr(slotBytes * SLOTS), flags));
+        if (mapped) {
+            return;
+        }
+        // 映射失败：不可变存储不能再 glBufferData，换一个缓冲区对象走孤立方式
+        glDeleteBuffers(1, &id);
+        glGenBuffers(1, &id);
+        glBindBuffer(target, id);
+    }
+    glBufferData(target, GLsizeiptr(slotBytes), nullptr, GL_STREAM_DRAW);
+}
+
+void StreamBuffer::destroy() {
+    if (!id) {
+        return;
+    }
+    for (GLsync& fence : fences) {
+        if (fence) glDeleteSync(fence);
+        fence = nullptr;
+    }
+    if (mapped) {
+        glBindBuffer(target, id);
+        glUnmapBuffer(target);
+        mapped = nullptr;
+    }
+    glDeleteBuffers(1, &id);
+    id = 0;
+    slot = 0;
+    drawSlot = -1;
+}
+
+void* StreamBuffer::beginWrite() {
+    if (mapped) {
+        GLsync& fence = fences[slot];
+        if (fence) {
+            // 先不阻塞地查一次，没完成才计一次等待，再带 flush 等到 GPU 读完为止
+            if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+                ++stallCount;
+                while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {
+                }
+            }
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+        return mapped + slotBytes * slot;
+    }
+    glBindBuffer(target, id);
+    glBufferData(target, GLsizeiptr(slotBytes), nullptr, GL_STREAM_DRAW); // 孤立旧存储
+    return glMapBufferRange(target, 0, GLsizeiptr(slotBytes), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+}
+
+size_t StreamBuffer::endWrite() {
+    if (mapped) {
+        drawSlot = slot;
+        slot = (slot + 1) % SLOTS;
+        return slotBytes * drawSlot; // 一致性映射，写入对之后提交的命令自动可见
+    }
+    glBindBuffer(target, id);
+    glUnmapBuffer(target);
+    return 0;
+}
+
+void StreamBuffer::endFrame() {
+    if (!mapped || drawSlot < 0) {
+        return;
+    }
+    GLsync& fence = fences[drawSlot];
+    if (fence) glDeleteSync(fence); // 新栅栏在旧栅栏之后，覆盖了之前所有读取这个槽的命令
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,43 @@
+﻿// stream_buffer.h
+// 每帧由 CPU 重写、GPU 读取的流式缓冲区。
+// GL 4.4+：一块持久映射（GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT）的缓冲区切成 SLOTS 个槽轮流写，
+// 映射只做一次，每个槽用栅栏（glFenceSync）记录 GPU 什么时候读完，CPU 只在追上 GPU 时才等待。
+// GL 3.3：退回到孤立（orphaning）——每帧 glBufferData(nullptr) 换一块新存储再映射，驱动负责避开 GPU 正在读的旧存储。
+// 两种方式都直接写映射出来的指针，不经过中间数组，也没有 glBufferSubData 的额外拷贝。
+#pragma once
+#include <glad/glad.h>
+#include <cstddef>
+
+class StreamBuffer {
+public:
+    static const int SLOTS = 3; // 三重缓冲：CPU 写一个槽时 GPU 最多还在读另外两个
+
+    StreamBuffer() = default;
+    ~StreamBuffer() { destroy(); }
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    // 创建并绑定到 target；allowPersistent = false 时即使支持 4.4 也用孤立方式（用于对比）
+    void create(GLenum target, size_t slotBytes, bool allowPersistent = true);
+    void destroy();
+
+    void* beginWrite();   // 当前槽的可写指针；持久映射时如果 GPU 还没读完这个槽会先等待
+    size_t endWrite();    // 写完，返回这个槽在缓冲区里的字节偏移（绘制时用），并换到下一个槽
+    // 读取最近写完的槽的绘制命令提交之后调用：给它插入栅栏。
+    // 某一帧没有新数据、直接重画上一个槽时也要调用，栅栏随之后移，下次写这个槽时会等到这一帧读完
+    void endFrame();
+
+    GLuint buffer() const { return id; }
+    bool persistent() const { return mapped != nullptr; }
+    unsigned long long stalls() const { return stallCount; } // beginWrite() 因为 GPU 没读完而等待的次数
+
+private:
+    GLenum target = GL_ARRAY_BUFFER;
+    GLuint id = 0;
+    size_t slotBytes = 0;
+    unsigned char* mapped = nullptr; // 持久映射的起始地址，孤立方式下为 nullptr
+    GLsync fences[SLOTS] = {};
+    int slot = 0;       // 下一次写的槽
+    int drawSlot = -1;  // 最近写完（正在被绘制）的槽
+    unsigned long long stallCount = 0;
+};
@@ -0,0 +1,84 @@
+﻿// thread_pool.cpp
+#include "thread_pool.h"
+#include "stencil_kernels.h"
+
+ThreadPool::ThreadPool(int threads) {
+    if (threads <= 0) {
+        threads = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    threadCount = threads > 0 ? threads : 1;
+    for (int i = 1; i < threadCount; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& t : workers) {
+        t.join();
+    }
+}
+
+void ThreadPool::run(const std::function<void(int, int)>& fn) {
+    if (threadCount == 1) {
+        fn(0, 1);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        task = &fn;
+        pending = threadCount - 1;
+        ++generation;
+    }
+    wake.notify_all();
+
+    fn(0, threadCount);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return pending == 0; });
+    task = nullptr;
+}
+
+void ThreadPool::workerLoop(int index) {
+    stencilFlushDenormals(); // MXCSR 是线程私有的，工作线程要自己设置
+    uint64_t seen = 0;
+    for (;;) {
+        const std::function<void(int, int)>* fn;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+            fn = task;
+        }
+
+        (*fn)(index, threadCount);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--pending == 0) {
+            done.notify_one();
+        }
+    }
+}
+
+// 计数 + 代数的自旋屏障：最后一个到达的线程清零计数并推进代数，其余线程等代数变化。
+// 时间步很短，先自旋，等久了再让出 CPU（线程数多于核心数时不至于卡死）
+void ThreadPool::barrier() {
+    if (threadCount == 1) return;
+    unsigned gen = barrierGeneration.load(std::memory_order_acquire);
+    if (barrierCount.fetch_add(1, std::memory_order_acq_rel) + 1 == threadCount) {
+        barrierCount.store(0, std::memory_order_relaxed);
+        barrierGeneration.fetch_add(1, std::memory_order_release);
+        return;
+    }
+    int spins = 0;
+    while (barrierGeneration.load(std::memory_order_acquire) == gen) {
+        if (++spins > 1000) {
+            std::this_thread::yield();
+        }
+    }
+}
@@ -0,0 +1,44 @@
+﻿// thread_pool.h
+// 常驻线程池：线程只创建一次，每次 run() 让所有线程（含调用线程）各执行一次任务，
+// 任务内部可以用 barrier() 让所有线程在同一时间步对齐。
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    explicit ThreadPool(int threads); // threads <= 0 时使用 std::thread::hardware_concurrency()
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return threadCount; }
+
+    // 线程 0 是调用线程，1..size()-1 是工作线程；所有线程执行完 task(线程号, 线程数) 后返回
+    void run(const std::function<void(int, int)>& task);
+
+    // 只能在 run() 的任务内部调用：所有线程都到达后才继续
+    void barrier();
+
+private:
+    void workerLoop(int index);
+
+    int threadCount;
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(int, int)>* task = nullptr;
+    uint64_t generation = 0; // 每次 run() 加 1，工作线程据此判断是否有新任务
+    int pending = 0;         // 尚未完成当前任务的工作线程数
+    bool stopping = false;
+
+    std::atomic<int> barrierCount{ 0 };
+    std::atomic<unsigned> barrierGeneration{ 0 };
+};
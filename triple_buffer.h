@@ -0,0 +1,39 @@
+﻿// triple_buffer.h
+// 单生产者、单消费者的无锁三重缓冲：生产者手里总有一块可写，消费者手里总有一块可读，第三块放在中间用来交换。
+// 双方各自只做一次原子交换，从不等待对方，也从不读写对方手里的那块；消费者总是拿到最新发布的一块，
+// 来不及取走的旧块直接被下一次发布覆盖（只丢中间帧，不丢最新帧）。
+#pragma once
+#include <atomic>
+
+template <class T>
+class TripleBuffer {
+public:
+    // 三块都要预先准备好（例如按网格大小分配），之后两端只通过 writeBuffer() / readBuffer() 访问
+    T& buffer(int index) { return buffers[index]; }
+
+    // 生产者：写这一块，写完调用 publish()
+    T& writeBuffer() { return buffers[writeIndex]; }
+    // 写好的块换到中间并标记为新，换回来的中间块作为下一次的写块
+    void publish() {
+        writeIndex = middle.exchange(writeIndex | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // 消费者：中间有新发布的块时换到读端并返回 true，否则读端不变（继续用上一块）
+    bool acquire() {
+        if (!(middle.load(std::memory_order_acquire) & FRESH)) {
+            return false;
+        }
+        readIndex = middle.exchange(readIndex, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+    const T& readBuffer() const { return buffers[readIndex]; }
+
+private:
+    static const int INDEX_MASK = 3;
+    static const int FRESH = 4; // 中间块是否尚未被消费者取走
+
+    T buffers[3];
+    int writeIndex = 0;           // 只由生产者访问
+    int readIndex = 1;            // 只由消费者访问
+    std::atomic<int> middle{ 2 }; // 中间块的下标 | FRESH
+};
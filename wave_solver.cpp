@@ -0,0 +1,478 @@
+﻿// wave_solver.cpp
+#include "wave_solver.h"
+#include "stencil_kernels.h"
+#include "thread_pool.h"
+#include "height_pack.h"
+#include "disturbance_queue.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+WaveSolver::WaveSolver(int width, int height, float courant2, float damping, WaveBoundary boundary)
+    : w(width), h(height), rowStride(paddedStride(width)),
+      courant2(courant2), damping(damping), boundary(boundary),
+      storage(3 * size_t(paddedStride(width)) * size_t(height)) {
+    prev = storage.data();
+    curr = prev + size_t(rowStride) * h;
+    next = curr + size_t(rowStride) * h;
+}
+
+void WaveSolver::reset() {
+    storage.zero();
+    spareStorage.zero();
+    if (sparse()) {
+        std::fill(tileActive.begin(), tileActive.end(), 0); // 全零的分块都可以休眠
+        for (SparseTileState& state : sparseState) state = SparseTileState{};
+        sparseSteps = sparseActiveSum = 0;
+    }
+}
+
+void WaveSolver::disturb(int x, int y, float amount) {
+    if (x >= 1 && x < w - 1 && y >= 1 && y < h - 1) {
+        curr[size_t(y) * rowStride + x] += amount;
+        if (sparse()) {
+            // 邻居分块的模板也会读到这一格（扰动落在分块边上时）
+            const int nx[5] = { x, x - 1, x + 1, x, x };
+            const int ny[5] = { y, y, y, y - 1, y + 1 };
+            for (int k = 0; k < 5; ++k) {
+                tileActive[size_t(sparseTileZ(ny[k])) * sparseTilesX + sparseTileX(nx[k])] = 1;
+            }
+        }
+    }
+}
+
+namespace {
+const int SPLAT_BAND_ROWS = 32; // 批量扰动的行带高度，每个行带只由一个线程写
+}
+
+void WaveSolver::splat(const Disturbance* events, size_t count) {
+    if (count == 0) {
+        return;
+    }
+    const int bands = (h + SPLAT_BAND_ROWS - 1) / SPLAT_BAND_ROWS;
+    splatSpans.resize(count);
+    splatBandStart.assign(bands + 1, 0);
+    int maxSpanWidth = 1;
+
+    // 第一遍：足迹裁剪到内部格子，统计每个行带覆盖到的事件数，稀疏模式下唤醒分块
+    for (size_t e = 0; e < count; ++e) {
+        const Disturbance& d = events[e];
+        SplatSpan& span = splatSpans[e];
+        if (d.radius > 0.0f) {
+            span = { int(std::ceil(d.x - d.radius)), int(std::floor(d.x + d.radius)),
+                     int(std::ceil(d.y - d.radius)), int(std::floor(d.y + d.radius)) };
+        }
+        else {
+            int x = int(std::lround(d.x)), y = int(std::lround(d.y));
+            span = { x, x, y, y };
+        }
+        span.x0 = std::max(span.x0, 1);
+        span.x1 = std::min(span.x1, w - 2);
+        span.y0 = std::max(span.y0, 1);
+        span.y1 = std::min(span.y1, h - 2);
+        if (span.x0 > span.x1 || span.y0 > span.y1) {
+            span.y0 = 1;
+            span.y1 = 0;
+            continue;
+        }
+        maxSpanWidth = std::max(maxSpanWidth, span.x1 - span.x0 + 1);
+        for (int b = span.y0 / SPLAT_BAND_ROWS; b <= span.y1 / SPLAT_BAND_ROWS; ++b) {
+            ++splatBandStart[b + 1];
+        }
+        if (sparse()) {
+            // 模板会从足迹外一圈读到这些格子
+            int tx0 = sparseTileX(span.x0 - 1), tx1 = sparseTileX(span.x1 + 1);
+            int tz0 = sparseTileZ(span.y0 - 1), tz1 = sparseTileZ(span.y1 + 1);
+            for (int tz = tz0; tz <= tz1; ++tz) {
+                std::fill(tileActive.begin() + size_t(tz) * sparseTilesX + tx0,
+                          tileActive.begin() + size_t(tz) * sparseTilesX + tx1 + 1, uint8_t(1));
+            }
+        }
+    }
+    for (int b = 0; b < bands; ++b) {
+        splatBandStart[b + 1] += splatBandStart[b];
+    }
+    // 第二遍：按事件顺序填进各行带的桶
+    splatBandEvents.resize(splatBandStart[bands]);
+    splatBandFill.assign(splatBandStart.begin(), splatBandStart.end() - 1);
+    for (size_t e = 0; e < count; ++e) {
+        const SplatSpan& span = splatSpans[e];
+        if (span.y0 > span.y1) continue;
+        for (int b = span.y0 / SPLAT_BAND_ROWS; b <= span.y1 / SPLAT_BAND_ROWS; ++b) {
+            splatBandEvents[splatBandFill[b]++] = int(e);
+        }
+    }
+
+    // 高斯足迹可分离：h += amplitude · exp(-(dx² + dy²) / (2σ²))，σ = radius / 3，每个事件先算一行权重
+    const int threadCount = pool && pool->size() > 1 ? pool->size() : 1;
+    splatWeights.resize(size_t(threadCount) * maxSpanWidth);
+    auto work = [&](int t, int n) {
+        float* weights = splatWeights.data() + size_t(t) * maxSpanWidth;
+        for (int b = t; b < bands; b += n) {
+            const int r0 = b * SPLAT_BAND_ROWS, r1 = std::min(r0 + SPLAT_BAND_ROWS, h) - 1;
+            for (int k = splatBandStart[b]; k < splatBandStart[b + 1]; ++k) {
+                const Disturbance& d = events[splatBandEvents[k]];
+                const SplatSpan& span = splatSpans[splatBandEvents[k]];
+                const int y0 = std::max(span.y0, r0), y1 = std::min(span.y1, r1);
+                if (d.radius <= 0.0f) {
+                    curr[size_t(y0) * rowStride + span.x0] += d.amplitude;
+                    continue;
+                }
+                const float falloff = 4.5f / (d.radius * d.radius); // 1 / (2σ²)
+                const int width = span.x1 - span.x0 + 1;
+                for (int x = span.x0; x <= span.x1; ++x) {
+                    float dx = float(x) - d.x;
+                    weights[x - span.x0] = std::exp(-falloff * dx * dx);
+                }
+                for (int y = y0; y <= y1; ++y) {
+                    float dy = float(y) - d.y;
+                    float rowAmplitude = d.amplitude * std::exp(-falloff * dy * dy);
+                    float* row = curr + size_t(y) * rowStride + span.x0;
+                    for (int i = 0; i < width; ++i) {
+                        row[i] += rowAmplitude * weights[i];
+                    }
+                }
+            }
+        }
+    };
+    if (pool && pool->size() > 1) {
+        pool->run(work);
+    }
+    else {
+        work(0, 1);
+    }
+}
+
+void WaveSolver::step() {
+    advance(1);
+}
+
+void WaveSolver::advance(int steps) {
+    if (sparse()) {
+        for (int s = 0; s < steps; ++s) {
+            stepSparse();
+        }
+        return;
+    }
+    if (blockSteps > 1 && steps >= blockSteps) {
+        advanceBlocked(steps / blockSteps);
+        steps %= blockSteps;
+    }
+    if (steps <= 0) {
+        return;
+    }
+    if (!pool || pool->size() == 1) {
+        for (int s = 0; s < steps; ++s) {
+            stepRows(1, h - 1, prev, curr, next);
+            rotate();
+        }
+        return;
+    }
+
+    // 每个线程负责一段连续的内部行（条带）。条带首尾各要读相邻条带的一行（halo 行），
+    // 所以每步结束后用屏障同步，保证下一步读到的 halo 行已经全部写完
+    pool->run([&](int t, int n) {
+        int j0 = 1 + (h - 2) * t / n;
+        int j1 = 1 + (h - 2) * (t + 1) / n;
+        float* p = prev;
+        float* c = curr;
+        float* x = next;
+        for (int s = 0; s < steps; ++s) {
+            stepRows(j0, j1, p, c, x);
+            pool->barrier();
+            float* recycled = p;
+            p = c;
+            c = x;
+            x = recycled;
+        }
+    });
+    for (int s = 0; s < steps; ++s) {
+        rotate();
+    }
+}
+
+// 计算内部行 [j0, j1)，并设置这些行自己的边界。Neumann 边界按行处理：先复制左右两列，
+// 第 1 行 / 倒数第 2 行再整行复制到上下边界行，结果与先行后列的整体处理完全相同
+void WaveSolver::stepRows(int j0, int j1, const float* p, const float* c, float* out) const {
+    // 输出与输入互不重叠，整段行交给 SIMD 内核；常用分辨率下走编译期特化版本
+    stencilWaveRows(out, c, p, w, h, j0, j1, courant2, damping);
+    if (boundary == WaveBoundary::Fixed) {
+        return; // 边界从未被写入，始终为 0
+    }
+    for (int j = j0; j < j1; ++j) {
+        float* row = out + size_t(j) * rowStride;
+        row[0] = row[1];
+        row[w - 1] = row[w - 2];
+    }
+    if (j0 == 1) {
+        std::copy(out + rowStride, out + rowStride + w, out);
+    }
+    if (j1 == h - 1) {
+        const float* src = out + size_t(h - 2) * rowStride;
+        std::copy(src, src + w, out + size_t(h - 1) * rowStride);
+    }
+}
+
+// 轮换：prev <- curr <- next，旧的 prev 下一步作为 next 被覆盖
+void WaveSolver::rotate() {
+    float* recycled = prev;
+    prev = curr;
+    curr = next;
+    next = recycled;
+}
+
+// --- 时间分块 ---
+void WaveSolver::setTemporalBlocking(int substeps, size_t tileBytes) {
+    blockSteps = substeps > 1 ? substeps : 1;
+    if (blockSteps == 1) {
+        return;
+    }
+    if (spareStorage.empty()) {
+        spareStorage.allocate(size_t(rowStride) * h); // 只分配一次，之后 spare 会和 prev/curr/next 互相轮换
+        spare = spareStorage.data();
+    }
+    // 分块连同每侧 substeps 格的重叠区，三个局部缓冲区一起放进 tileBytes
+    int halo = 2 * blockSteps;
+    tileCols = std::min(w, 512);
+    size_t rowBytes = 3 * sizeof(float) * size_t(paddedStride(tileCols + halo));
+    tileRows = std::max(blockSteps, int(tileBytes / rowBytes) - halo);
+    tileRows = std::min(tileRows, h);
+}
+
+// 重叠分块（ghost zone）：每块连同四周 K 格读进局部缓冲区，推进 K 步，每推进一步有效区域向内缩一格，
+// K 步后正好剩下分块本身。相邻分块重叠区的计算是重复的，换来整个网格每 K 步只读写一次内存
+void WaveSolver::advanceBlocked(int chunks) {
+    std::vector<Tile> tiles;
+    for (int r0 = 0; r0 < h; r0 += tileRows) {
+        for (int c0 = 0; c0 < w; c0 += tileCols) {
+            tiles.push_back({ r0, std::min(h, r0 + tileRows), c0, std::min(w, c0 + tileCols) });
+        }
+    }
+    int threads = pool ? pool->size() : 1;
+    size_t localSize = size_t(tileRows + 2 * blockSteps) * paddedStride(tileCols + 2 * blockSteps);
+    if (tileScratch.size() < 3 * localSize * threads) {
+        tileScratch.allocate(3 * localSize * threads);
+    }
+
+    // 分块之间互不依赖：只读旧的 prev/curr，写入新的 prev（spare）和 curr（next）
+    auto work = [&](int t, int n) {
+        float* local = tileScratch.data() + 3 * localSize * t;
+        float* gp = prev;
+        float* gc = curr;
+        float* gn = next;
+        float* gs = spare;
+        for (int chunk = 0; chunk < chunks; ++chunk) {
+            for (size_t k = t; k < tiles.size(); k += n) {
+                runTile(tiles[k], gp, gc, gs, gn, local);
+            }
+            if (n > 1) pool->barrier();
+            float* oldPrev = gp;
+            float* oldCurr = gc;
+            gp = gs;
+            gc = gn;
+            gn = oldPrev;
+            gs = oldCurr;
+        }
+    };
+    if (threads > 1) {
+        pool->run(work);
+    }
+    else {
+        work(0, 1);
+    }
+
+    for (int chunk = 0; chunk < chunks; ++chunk) {
+        float* oldPrev = prev;
+        float* oldCurr = curr;
+        prev = spare;
+        curr = next;
+        next = oldPrev;
+        spare = oldCurr;
+    }
+}
+
+void WaveSolver::runTile(const Tile& tile, const float* gp, const float* gc,
+                         float* outPrev, float* outCurr, float* local) const {
+    const int K = blockSteps;
+    const int lw = paddedStride(tileCols + 2 * K); // 局部行跨度
+    const size_t localSize = size_t(tileRows + 2 * K) * lw;
+    // Neumann 边界行/列等于同一时刻的相邻内部行/列，所以分块至少要包含一行（列）内部格子，
+    // 只含边界行的退化分块向内扩一格
+    const int r0 = std::min(tile.r0, h - 2), r1 = std::max(tile.r1, 2);
+    const int c0 = std::min(tile.c0, w - 2), c1 = std::max(tile.c1, 2);
+    const int br0 = std::max(0, r0 - K), br1 = std::min(h, r1 + K);
+    const int bc0 = std::max(0, c0 - K), bc1 = std::min(w, c1 + K);
+    auto at = [&](float* buf, int j, int i) { return buf + size_t(j - br0) * lw + (i - bc0); };
+
+    float* lp = local;
+    float* lc = local + localSize;
+    float* ln = local + 2 * localSize;
+    for (int j = br0; j < br1; ++j) {
+        size_t row = size_t(j) * rowStride;
+        std::copy(gp + row + bc0, gp + row + bc1, at(lp, j, bc0));
+        std::copy(gc + row + bc0, gc + row + bc1, at(lc, j, bc0));
+    }
+    if (boundary == WaveBoundary::Fixed) {
+        // ln 是上一个分块留下的内容，其中落在网格边界上的格子必须清零
+        if (br0 == 0) std::fill(at(ln, 0, bc0), at(ln, 0, bc1), 0.0f);
+        if (br1 == h) std::fill(at(ln, h - 1, bc0), at(ln, h - 1, bc1), 0.0f);
+        for (int j = br0; j < br1; ++j) {
+            if (bc0 == 0) *at(ln, j, 0) = 0.0f;
+            if (bc1 == w) *at(ln, j, w - 1) = 0.0f;
+        }
+    }
+
+    for (int s = 1; s <= K; ++s) {
+        const int rlo = std::max(1, r0 - K + s), rhi = std::min(h - 1, r1 + K - s);
+        const int clo = std::max(1, c0 - K + s), chi = std::min(w - 1, c1 + K - s);
+        for (int j = rlo; j < rhi; ++j) {
+            stencilWaveRow(at(ln, j, clo), at(lc, j, clo), at(lp, j, clo), lw, chi - clo, courant2, damping);
+        }
+        if (boundary == WaveBoundary::Neumann) {
+            for (int j = rlo; j < rhi; ++j) {
+                if (clo == 1) *at(ln, j, 0) = *at(ln, j, 1);
+                if (chi == w - 1) *at(ln, j, w - 1) = *at(ln, j, w - 2);
+            }
+            const int ec0 = clo == 1 ? 0 : clo, ec1 = chi == w - 1 ? w : chi;
+            if (rlo == 1) std::copy(at(ln, 1, ec0), at(ln, 1, ec1), at(ln, 0, ec0));
+            if (rhi == h - 1) std::copy(at(ln, h - 2, ec0), at(ln, h - 2, ec1), at(ln, h - 1, ec0));
+        }
+        float* recycled = lp;
+        lp = lc;
+        lc = ln;
+        ln = recycled;
+    }
+
+    for (int j = tile.r0; j < tile.r1; ++j) {
+        size_t row = size_t(j) * rowStride + tile.c0;
+        std::copy(at(lp, j, tile.c0), at(lp, j, tile.c1), outPrev + row);
+        std::copy(at(lc, j, tile.c0), at(lc, j, tile.c1), outCurr + row);
+    }
+}
+
+// --- 稀疏模式 ---
+void WaveSolver::setSparse(float epsilon, int tileSize) {
+    sparseEpsilon = epsilon > 0.0f ? epsilon : 0.0f;
+    if (!sparse()) {
+        return;
+    }
+    sparseTile = tileSize;
+    // Neumann 边界行/列要复制同一分块里的相邻内部行/列：只剩一格（只含边界）的最后一行 / 列分块
+    // 会读写邻居分块的格子，并在邻居休眠时漏掉更新，所以并进前一个分块（尺寸 ≡ 1 (mod tileSize) 时）
+    sparseTilesX = std::max(1, (w - 2) / tileSize + 1);
+    sparseTilesZ = std::max(1, (h - 2) / tileSize + 1);
+    sparseTiles.clear();
+    for (int tz = 0; tz < sparseTilesZ; ++tz) {
+        const int r0 = tz * tileSize, r1 = tz + 1 == sparseTilesZ ? h : r0 + tileSize;
+        for (int tx = 0; tx < sparseTilesX; ++tx) {
+            const int c0 = tx * tileSize, c1 = tx + 1 == sparseTilesX ? w : c0 + tileSize;
+            sparseTiles.push_back({ r0, r1, c0, c1 });
+        }
+    }
+    // 当前内容未知，先全部活跃，全零的分块两步后自然休眠
+    tileActive.assign(sparseTiles.size(), 1);
+    tileWake.assign(sparseTiles.size(), 0);
+    sparseState.assign(sparseTiles.size(), SparseTileState{});
+    sparseSteps = sparseActiveSum = 0;
+}
+
+void WaveSolver::wakeAllTiles() {
+    std::fill(tileActive.begin(), tileActive.end(), 1);
+}
+
+WaveSolver::SparseStats WaveSolver::sparseStats() const {
+    int active = 0;
+    for (uint8_t a : tileActive) active += a;
+    return { int(sparseTiles.size()), active, sparseSteps ? double(sparseActiveSum) / double(sparseSteps) : 0.0 };
+}
+
+// 稀疏模式每隔这么多步检查一次哪些分块可以休眠；波前到达的唤醒每步都检查
+static const int SPARSE_SLEEP_INTERVAL = 8;
+
+// 推进一个分块的内部格子（边界行列照 stepRows() 处理），再趁新高度还在缓存里统计四条边，需要时统计整块最大值
+void WaveSolver::stepSparseTile(int index, bool checkSleep) {
+    const Tile& tile = sparseTiles[index];
+    const int j0 = std::max(tile.r0, 1), j1 = std::min(tile.r1, h - 1);
+    const int i0 = std::max(tile.c0, 1), i1 = std::min(tile.c1, w - 1);
+    size_t first = size_t(j0) * rowStride + i0;
+    stencilWaveRect(next + first, curr + first, prev + first, rowStride, i1 - i0, j1 - j0, courant2, damping);
+    if (boundary == WaveBoundary::Neumann) {
+        for (int j = j0; j < j1; ++j) {
+            float* row = next + size_t(j) * rowStride;
+            if (tile.c0 == 0) row[0] = row[1];
+            if (tile.c1 == w) row[w - 1] = row[w - 2];
+        }
+        const int count = tile.c1 - tile.c0;
+        if (tile.r0 == 0) std::copy_n(next + rowStride + tile.c0, count, next + tile.c0);
+        if (tile.r1 == h) std::copy_n(next + size_t(h - 2) * rowStride + tile.c0, count, next + size_t(h - 1) * rowStride + tile.c0);
+    }
+
+    SparseTileState& state = sparseState[index];
+    const int count = tile.c1 - tile.c0;
+    float left = 0.0f, right = 0.0f;
+    for (int j = tile.r0; j < tile.r1; ++j) {
+        const float* row = next + size_t(j) * rowStride + tile.c0;
+        left = std::max(left, std::fabs(row[0]));
+        right = std::max(right, std::fabs(row[count - 1]));
+    }
+    if (checkSleep) {
+        float m = 0.0f;
+        for (int j = tile.r0; j < tile.r1; ++j) {
+            size_t row = size_t(j) * rowStride + tile.c0;
+            m = std::max(m, std::max(maxAbsHeight(next + row, count), maxAbsHeight(curr + row, count)));
+        }
+        state.maxAbs = m;
+    }
+    state.edge[0] = maxAbsHeight(next + size_t(tile.r0) * rowStride + tile.c0, count);
+    state.edge[1] = maxAbsHeight(next + size_t(tile.r1 - 1) * rowStride + tile.c0, count);
+    state.edge[2] = left;
+    state.edge[3] = right;
+}
+
+void WaveSolver::stepSparse() {
+    activeList.clear();
+    for (size_t k = 0; k < tileActive.size(); ++k) {
+        if (tileActive[k]) activeList.push_back(int(k));
+    }
+
+    // 分块之间只通过上一步的 curr 相互读取，同一步内互不依赖
+    const bool checkSleep = sparseSteps % SPARSE_SLEEP_INTERVAL == SPARSE_SLEEP_INTERVAL - 1;
+    auto work = [&](int t, int n) {
+        for (size_t k = t; k < activeList.size(); k += n) {
+            stepSparseTile(activeList[k], checkSleep);
+        }
+    };
+    if (pool && pool->size() > 1) {
+        pool->run(work);
+    }
+    else {
+        work(0, 1);
+    }
+    rotate();
+
+    // 更新活跃集：还有能量的分块保持活跃，波前到达边上时唤醒对应的邻居
+    std::fill(tileWake.begin(), tileWake.end(), 0);
+    for (int k : activeList) {
+        const SparseTileState& state = sparseState[k];
+        const int tx = k % sparseTilesX, tz = k / sparseTilesX;
+        if (!checkSleep || state.maxAbs >= sparseEpsilon) tileWake[k] = 1;
+        if (tz > 0 && state.edge[0] >= sparseEpsilon) tileWake[k - sparseTilesX] = 1;
+        if (tz + 1 < sparseTilesZ && state.edge[1] >= sparseEpsilon) tileWake[k + sparseTilesX] = 1;
+        if (tx > 0 && state.edge[2] >= sparseEpsilon) tileWake[k - 1] = 1;
+        if (tx + 1 < sparseTilesX && state.edge[3] >= sparseEpsilon) tileWake[k + 1] = 1;
+    }
+    // 入睡的分块在三个缓冲区里清零；被唤醒的分块原本就是零，状态从零开始
+    for (int k : activeList) {
+        if (tileWake[k]) continue;
+        const Tile& tile = sparseTiles[k];
+        for (float* buffer : { prev, curr, next }) {
+            for (int j = tile.r0; j < tile.r1; ++j) {
+                std::fill_n(buffer + size_t(j) * rowStride + tile.c0, tile.c1 - tile.c0, 0.0f);
+            }
+        }
+        sparseState[k] = SparseTileState{};
+    }
+    sparseActiveSum += activeList.size();
+    ++sparseSteps;
+    tileActive.swap(tileWake);
+}
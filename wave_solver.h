@@ -0,0 +1,115 @@
+﻿// wave_solver.h
+// 二维波动方程有限差分求解器：prev/curr/next 三个高度缓冲区，每步交换指针轮换。
+// 网格大小在运行时指定，缓冲区 64 字节对齐，行跨度 stride() 补齐到缓存行（>= width()）
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "aligned_buffer.h"
+
+class ThreadPool;
+struct Disturbance;
+
+// 边界条件
+enum class WaveBoundary {
+    Fixed,   // 边界高度固定为 0（height_field.cpp）
+    Neumann  // 边界复制相邻内部值，法向导数为 0（SWE.cpp）
+};
+
+class WaveSolver {
+public:
+    // courant2 = (c·dt/dx)^2，damping 每步乘到新高度上（1 表示无阻尼）
+    WaveSolver(int width, int height, float courant2, float damping,
+               WaveBoundary boundary = WaveBoundary::Fixed);
+
+    void step();                              // 推进一步：只读 prev/curr，只写 next，然后轮换
+    void advance(int steps);                  // 连续推进多步；有线程池时整段只分派一次，步与步之间用屏障同步
+    void disturb(int x, int y, float amount); // 在当前高度上叠加扰动（稀疏模式下同时唤醒所在分块）
+    // 一次叠加一批高斯扰动（忽略 time 字段）：事件按 32 行的行带分桶，有线程池时各行带并行，
+    // 同一格上的事件按数组顺序叠加，结果与线程数无关。足迹裁剪到内部格子，稀疏模式下唤醒覆盖到的分块
+    void splat(const Disturbance* events, size_t count);
+    void reset();                             // 所有缓冲区清零（稀疏模式下所有分块休眠）
+
+    void setThreadPool(ThreadPool* threads) { pool = threads; } // nullptr 表示单线程
+
+    // 时间分块：advance() 时把网格切成缓存大小的分块，每块连续推进 substeps 步再换下一块，
+    // 整个网格每 substeps 步只经过内存一次。substeps <= 1 关闭。结果与逐步推进逐位一致
+    void setTemporalBlocking(int substeps, size_t tileBytes = 512 * 1024);
+    int temporalBlocking() const { return blockSteps; }
+
+    // 稀疏模式：网格按 tileSize×tileSize 分块，每步只推进活跃块。活跃块的当前和上一步高度都低于 epsilon 时休眠，
+    // 休眠块在三个缓冲区里都清零，所以跳过它与照常计算一致（误差不超过 epsilon）；相邻活跃块朝向它的边上
+    // 出现不低于 epsilon 的高度（波前到达）或者 disturb() 落在块内时唤醒。几处局部扰动的开销与活跃面积成正比，
+    // 而不是整个网格。epsilon <= 0 关闭。开启后 advance() 不做时间分块。最后一行 / 列分块不足两格时并进前一块
+    void setSparse(float epsilon, int tileSize = 32);
+    bool sparse() const { return sparseEpsilon > 0.0f; }
+    struct SparseStats {
+        int tiles;            // 分块总数
+        int active;           // 当前活跃块数
+        double averageActive; // 自 setSparse() / reset() 以来每步平均活跃块数
+    };
+    SparseStats sparseStats() const;
+
+    int width() const { return w; }
+    int height() const { return h; }
+    int stride() const { return rowStride; }    // 行跨度（float 个数）
+    float at(int x, int y) const { return curr[size_t(y) * rowStride + x]; }
+    const float* data() const { return curr; }  // 当前高度，第 y 行从 data() + y * stride() 开始
+    float* mutableData() { wakeAllTiles(); return curr; } // 用于设置初始条件（稀疏模式下唤醒全部分块）
+    float* previousData() { wakeAllTiles(); return prev; }
+
+private:
+    struct Tile { int r0, r1, c0, c1; };
+
+    void stepRows(int j0, int j1, const float* p, const float* c, float* out) const;
+    void rotate();
+    void advanceBlocked(int chunks);
+    void runTile(const Tile& tile, const float* gp, const float* gc,
+                 float* outPrev, float* outCurr, float* local) const;
+    void stepSparse();
+    void stepSparseTile(int index, bool checkSleep);
+    void wakeAllTiles();
+    // 第 x 列 / 第 y 行所在的稀疏分块（最后一块可能比 sparseTile 宽一格）
+    int sparseTileX(int x) const { return std::min(x / sparseTile, sparseTilesX - 1); }
+    int sparseTileZ(int y) const { return std::min(y / sparseTile, sparseTilesZ - 1); }
+
+    struct SplatSpan { int x0, x1, y0, y1; }; // 裁剪后的足迹（闭区间），y0 > y1 表示完全落在边界外
+
+    int w, h;
+    int rowStride;
+    float courant2;
+    float damping;
+    WaveBoundary boundary;
+    AlignedBuffer storage;      // 三个缓冲区共用一块内存
+    float* prev;
+    float* curr;
+    float* next;
+    ThreadPool* pool = nullptr;
+
+    // 时间分块
+    int blockSteps = 1;
+    int tileRows = 0, tileCols = 0;
+    AlignedBuffer spareStorage; // 第四个全局缓冲区：分块输出需要同时写新的 prev 和 curr
+    float* spare = nullptr;
+    AlignedBuffer tileScratch;  // 每个线程三个局部分块缓冲区
+
+    // 稀疏模式
+    struct SparseTileState {
+        float maxAbs;  // 新的 curr 和 prev 的最大绝对值（只在检查休眠的那一步统计），低于 epsilon 才休眠
+        float edge[4]; // 上、下、左、右四条边（新的 curr）的最大绝对值，每步统计，决定是否唤醒对应的邻居
+    };
+    float sparseEpsilon = 0.0f;
+    int sparseTile = 32;
+    int sparseTilesX = 0, sparseTilesZ = 0;
+    std::vector<Tile> sparseTiles;
+    std::vector<SparseTileState> sparseState;
+    std::vector<uint8_t> tileActive, tileWake;
+    std::vector<int> activeList;
+    uint64_t sparseSteps = 0, sparseActiveSum = 0;
+
+    // 批量扰动的分桶结果，留着复用避免每步分配
+    std::vector<SplatSpan> splatSpans;
+    std::vector<int> splatBandStart, splatBandEvents, splatBandFill;
+    std::vector<float> splatWeights; // 每个线程一行足迹权重，行长为本批最宽的足迹
+};